@@ -0,0 +1,99 @@
+#include "AssetPrefetcher.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace Aftr;
+
+AssetPrefetcher::AssetPrefetcher()
+{
+    stopping = false;
+    worker = std::thread([this]() { run(); });
+}
+
+AssetPrefetcher::~AssetPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+}
+
+void AssetPrefetcher::request(const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!requested.insert(path).second)
+            return;
+        requests.push_back(path);
+    }
+    cv.notify_one();
+}
+
+bool AssetPrefetcher::isReady(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready.count(path) != 0;
+}
+
+void AssetPrefetcher::run()
+{
+    while (true) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping)
+                break;
+            path = requests.front();
+            requests.pop_front();
+        }
+
+        // file I/O happens outside the lock so the main thread never waits on the disk
+        std::deque<std::string> dependencies;
+        prefetch(path, dependencies);
+        while (!dependencies.empty()) {
+            std::string dependency = dependencies.front();
+            dependencies.pop_front();
+            prefetch(dependency, dependencies);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.insert(path);
+    }
+}
+
+void AssetPrefetcher::prefetch(const std::string& path, std::deque<std::string>& out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return;
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    // follow material libraries of OBJ files and the texture maps of those libraries
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    if (extension != "obj" && extension != "mtl")
+        return;
+
+    size_t slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    std::string line;
+    while (std::getline(contents, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (extension == "obj" ? keyword != "mtllib" : keyword.compare(0, 4, "map_") != 0)
+            continue;
+
+        // the file name is the last token, options may come before it
+        std::string name, token;
+        while (tokens >> token)
+            name = token;
+        if (!name.empty())
+            out.push_back(directory + name);
+    }
+}
\ No newline at end of file
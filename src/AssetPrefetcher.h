@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace Aftr {
+// Warms the OS file cache: reads model files (and the material libraries and textures
+// they reference) on a background thread and throws the bytes away, so that the first
+// load of a model on the main thread doesn't stall on the disk. Nothing parsed is handed
+// over; Aftr's loader creates GL objects while it parses, so the parse itself stays on
+// the main thread.
+class AssetPrefetcher {
+public:
+    AssetPrefetcher();
+    ~AssetPrefetcher();
+    AssetPrefetcher(const AssetPrefetcher& other) = delete;
+    AssetPrefetcher& operator=(const AssetPrefetcher& other) = delete;
+
+    // queues path for reading, does nothing if it was already requested
+    void request(const std::string& path);
+    // true once path has been read (or failed to, the loader reports that)
+    bool isReady(const std::string& path);
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> requests;
+    std::unordered_set<std::string> requested;
+    std::unordered_set<std::string> ready;
+    bool stopping;
+
+    void run();
+    // reads path completely, appends the files it references to out
+    static void prefetch(const std::string& path, std::deque<std::string>& out);
+};
+}
\ No newline at end of file
@@ -0,0 +1,308 @@
+#include "BinaryMesh.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "PxPhysicsAPI.h"
+
+using namespace Aftr;
+using namespace physx;
+
+static uint64_t alignSection(uint64_t offset)
+{
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// size and modification time of fileName, false if it can't be stat'ed
+static bool getSourceStamp(const std::string& fileName, uint64_t& size, int64_t& modified)
+{
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(fileName.c_str(), &info) != 0)
+        return false;
+#else
+    struct stat info;
+    if (stat(fileName.c_str(), &info) != 0)
+        return false;
+#endif
+    size = uint64_t(info.st_size);
+    modified = int64_t(info.st_mtime);
+    return true;
+}
+
+BinaryMesh::BinaryMesh()
+{
+    data = nullptr;
+    size = 0;
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#else
+    file = -1;
+#endif
+}
+
+BinaryMesh::~BinaryMesh()
+{
+    close();
+}
+
+bool BinaryMesh::open(const std::string& fileName)
+{
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= LONGLONG(sizeof(BinaryMeshHeader))) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            size = size_t(fileSize.QuadPart);
+        }
+    }
+#else
+    file = ::open(fileName.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) == 0 && size_t(info.st_size) >= sizeof(BinaryMeshHeader)) {
+        void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) {
+            data = static_cast<const char*>(view);
+            size = size_t(info.st_size);
+        }
+    }
+#endif
+
+    if (data == nullptr || !isValid()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void BinaryMesh::close()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#else
+    if (data != nullptr)
+        munmap(const_cast<char*>(data), size);
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool BinaryMesh::isValid() const
+{
+    const BinaryMeshHeader* h = header();
+    if (h->magic != MAGIC || h->version != VERSION)
+        return false;
+
+    // every section has to lie inside the file, so nothing needs checking on access
+    auto inside = [this](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+    return inside(h->verticesOffset, uint64_t(h->numVertices) * 3 * sizeof(float))
+        && inside(h->indicesOffset, uint64_t(h->numIndices) * sizeof(uint32_t))
+        && inside(h->cookedTriangleMeshOffset, h->cookedTriangleMeshSize)
+        && inside(h->cookedConvexMeshOffset, h->cookedConvexMeshSize);
+}
+
+bool BinaryMesh::isConversionOf(const std::string& modelFileName, const Vector& scale) const
+{
+    const BinaryMeshHeader* h = header();
+    if (h->scale[0] != scale.x || h->scale[1] != scale.y || h->scale[2] != scale.z)
+        return false;
+
+    uint64_t sourceSize;
+    int64_t sourceModified;
+    return getSourceStamp(modelFileName, sourceSize, sourceModified) && h->sourceSize == sourceSize && h->sourceModified == sourceModified;
+}
+
+const float* BinaryMesh::getVertices() const
+{
+    return reinterpret_cast<const float*>(data + header()->verticesOffset);
+}
+
+const uint32_t* BinaryMesh::getIndices() const
+{
+    return reinterpret_cast<const uint32_t*>(data + header()->indicesOffset);
+}
+
+const void* BinaryMesh::getCookedTriangleMesh(size_t& size) const
+{
+    const BinaryMeshHeader* h = header();
+    size = size_t(h->cookedTriangleMeshSize);
+    if (h->cookedTriangleMeshOffset == 0 || h->physxVersion != PX_PHYSICS_VERSION)
+        return nullptr;
+    return data + h->cookedTriangleMeshOffset;
+}
+
+const void* BinaryMesh::getCookedConvexMesh(size_t& size) const
+{
+    const BinaryMeshHeader* h = header();
+    size = size_t(h->cookedConvexMeshSize);
+    if (h->cookedConvexMeshOffset == 0 || h->physxVersion != PX_PHYSICS_VERSION)
+        return nullptr;
+    return data + h->cookedConvexMeshOffset;
+}
+
+std::string BinaryMesh::getBinaryFileName(const std::string& modelFileName)
+{
+    size_t dot = modelFileName.find_last_of('.');
+    size_t slash = modelFileName.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return modelFileName + ".amesh";
+    return modelFileName.substr(0, dot) + ".amesh";
+}
+
+bool BinaryMesh::convertOBJ(const std::string& objFileName, const std::string& fileName, const Vector& scale)
+{
+    std::ifstream obj(objFileName);
+    if (!obj) {
+        std::cout << "Could not open " << objFileName << std::endl;
+        return false;
+    }
+
+    // positions and faces are all physics needs, faces are triangulated as fans
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> face;
+    std::string line, keyword, token;
+    while (std::getline(obj, line)) {
+        std::istringstream tokens(line);
+        tokens >> keyword;
+        if (keyword == "v") {
+            float p[3] = { 0.0f, 0.0f, 0.0f };
+            tokens >> p[0] >> p[1] >> p[2];
+            vertices.push_back(p[0] * scale.x);
+            vertices.push_back(p[1] * scale.y);
+            vertices.push_back(p[2] * scale.z);
+        } else if (keyword == "f") {
+            face.clear();
+            while (tokens >> token) {
+                // v, v/vt, v//vn or v/vt/vn; negative indices count back from the last vertex
+                long index = std::strtol(token.c_str(), nullptr, 10);
+                long numVertices = long(vertices.size() / 3);
+                index = index < 0 ? numVertices + index : index - 1;
+                if (index < 0 || index >= numVertices) {
+                    std::cout << "Invalid face in " << objFileName << ": " << line << std::endl;
+                    return false;
+                }
+                face.push_back(uint32_t(index));
+            }
+            for (size_t i = 2; i < face.size(); ++i) {
+                indices.push_back(face[0]);
+                indices.push_back(face[i - 1]);
+                indices.push_back(face[i]);
+            }
+        }
+        keyword.clear();
+    }
+    if (vertices.empty() || indices.empty()) {
+        std::cout << objFileName << " has no triangles" << std::endl;
+        return false;
+    }
+
+    // cook with the same parameters PhysXEngine uses, so the result loads as is
+    PxDefaultAllocator allocator;
+    PxDefaultErrorCallback errCallback;
+    PxFoundation* foundation = PxCreateFoundation(PX_PHYSICS_VERSION, allocator, errCallback);
+    PxCooking* cooking = PxCreateCooking(PX_PHYSICS_VERSION, *foundation, PxCookingParams(PxTolerancesScale()));
+
+    PxTriangleMeshDesc triangleDesc;
+    triangleDesc.points.count = PxU32(vertices.size() / 3);
+    triangleDesc.points.stride = 3 * sizeof(float);
+    triangleDesc.points.data = vertices.data();
+    triangleDesc.triangles.count = PxU32(indices.size() / 3);
+    triangleDesc.triangles.stride = 3 * sizeof(uint32_t);
+    triangleDesc.triangles.data = indices.data();
+    PxDefaultMemoryOutputStream cookedTriangleMesh;
+    bool hasTriangleMesh = cooking->cookTriangleMesh(triangleDesc, cookedTriangleMesh);
+
+    PxConvexMeshDesc convexDesc;
+    convexDesc.points.count = PxU32(vertices.size() / 3);
+    convexDesc.points.stride = 3 * sizeof(float);
+    convexDesc.points.data = vertices.data();
+    convexDesc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
+    PxDefaultMemoryOutputStream cookedConvexMesh;
+    bool hasConvexMesh = cooking->cookConvexMesh(convexDesc, cookedConvexMesh);
+
+    BinaryMeshHeader h;
+    std::memset(&h, 0, sizeof(h));
+    h.magic = MAGIC;
+    h.version = VERSION;
+    h.physxVersion = PX_PHYSICS_VERSION;
+    h.numVertices = uint32_t(vertices.size() / 3);
+    h.numIndices = uint32_t(indices.size());
+    h.scale[0] = scale.x;
+    h.scale[1] = scale.y;
+    h.scale[2] = scale.z;
+    getSourceStamp(objFileName, h.sourceSize, h.sourceModified);
+    h.verticesOffset = alignSection(sizeof(h));
+    h.indicesOffset = alignSection(h.verticesOffset + vertices.size() * sizeof(float));
+    uint64_t end = h.indicesOffset + indices.size() * sizeof(uint32_t);
+    if (hasTriangleMesh) {
+        h.cookedTriangleMeshOffset = alignSection(end);
+        h.cookedTriangleMeshSize = cookedTriangleMesh.getSize();
+        end = h.cookedTriangleMeshOffset + h.cookedTriangleMeshSize;
+    }
+    if (hasConvexMesh) {
+        h.cookedConvexMeshOffset = alignSection(end);
+        h.cookedConvexMeshSize = cookedConvexMesh.getSize();
+        end = h.cookedConvexMeshOffset + h.cookedConvexMeshSize;
+    }
+
+    std::vector<char> out(size_t(end), 0);
+    std::memcpy(&out[0], &h, sizeof(h));
+    std::memcpy(&out[size_t(h.verticesOffset)], vertices.data(), vertices.size() * sizeof(float));
+    std::memcpy(&out[size_t(h.indicesOffset)], indices.data(), indices.size() * sizeof(uint32_t));
+    if (hasTriangleMesh)
+        std::memcpy(&out[size_t(h.cookedTriangleMeshOffset)], cookedTriangleMesh.getData(), cookedTriangleMesh.getSize());
+    if (hasConvexMesh)
+        std::memcpy(&out[size_t(h.cookedConvexMeshOffset)], cookedConvexMesh.getData(), cookedConvexMesh.getSize());
+
+    cooking->release();
+    foundation->release();
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), std::streamsize(out.size()));
+    if (!file) {
+        std::cout << "Could not write " << fileName << std::endl;
+        return false;
+    }
+
+    std::cout << "Converted " << objFileName << " to " << fileName << ": " << h.numVertices << " vertices, "
+              << h.numIndices / 3 << " triangles" << (hasTriangleMesh ? ", cooked triangle mesh" : "")
+              << (hasConvexMesh ? ", cooked convex mesh" : "") << std::endl;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "Vector.h"
+
+namespace Aftr {
+// Layout of a binary mesh file, native (little endian) byte order, every section
+// aligned to 16 bytes so it can be used straight from the mapping:
+//   header (see below)
+//   numVertices * 3 floats      positions, initial scale already applied
+//   numIndices * u32            triangle list
+//   cooked PxTriangleMesh       optional, as written by PxCooking::cookTriangleMesh
+//   cooked PxConvexMesh         optional, as written by PxCooking::cookConvexMesh
+// Cooked data is only used by the PhysX version that produced it.
+// The converter reads the OBJ with its own minimal reader (positions and faces only),
+// not Aftr's loader, so collision follows the file's v/f records even where Aftr's loader
+// reads the file differently from what is drawn.
+struct BinaryMeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t physxVersion; // PX_PHYSICS_VERSION the cooked sections were made with
+    uint32_t numVertices;
+    uint32_t numIndices;
+    float scale[3];
+    uint64_t sourceSize; // size and modification time of the OBJ it was converted from
+    int64_t sourceModified;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t cookedTriangleMeshOffset; // 0 if absent
+    uint64_t cookedTriangleMeshSize;
+    uint64_t cookedConvexMeshOffset; // 0 if absent
+    uint64_t cookedConvexMeshSize;
+};
+
+// Read only, memory mapped view of a binary mesh file. Nothing is parsed or
+// copied; the pointers handed out stay valid until the file is closed.
+class BinaryMesh {
+public:
+    static const uint32_t MAGIC = 0x48534D41; // "AMSH"
+    static const uint32_t VERSION = 2; // 2: source size and modification time
+
+    BinaryMesh();
+    ~BinaryMesh();
+    BinaryMesh(const BinaryMesh& other) = delete;
+    BinaryMesh& operator=(const BinaryMesh& other) = delete;
+
+    // maps fileName, returns false if it doesn't exist or isn't a valid binary mesh
+    bool open(const std::string& fileName);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    // true if the mesh was converted from modelFileName as it is now, with the given initial
+    // scale; a stale conversion is ignored and the model is cooked from its loaded mesh instead
+    bool isConversionOf(const std::string& modelFileName, const Vector& scale) const;
+    const float* getVertices() const; // 3 floats per vertex
+    size_t getNumVertices() const { return header()->numVertices; }
+    const uint32_t* getIndices() const;
+    size_t getNumIndices() const { return header()->numIndices; }
+    // cooked sections, nullptr if absent or cooked by a different PhysX version
+    const void* getCookedTriangleMesh(size_t& size) const;
+    const void* getCookedConvexMesh(size_t& size) const;
+
+    // binary mesh that belongs to a model file: same path, extension replaced by .amesh
+    static std::string getBinaryFileName(const std::string& modelFileName);
+    // offline converter, reads the positions and faces of an OBJ file, cooks them
+    // both ways and writes the result to fileName
+    static bool convertOBJ(const std::string& objFileName, const std::string& fileName, const Vector& scale);
+
+private:
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int file;
+#endif
+
+    const BinaryMeshHeader* header() const { return reinterpret_cast<const BinaryMeshHeader*>(data); }
+    bool isValid() const;
+};
+}
\ No newline at end of file
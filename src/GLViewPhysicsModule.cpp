@@ -1,15 +1,26 @@
 #include "GLViewPhysicsModule.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
 
 #include "Axes.h" //We can set Axes to on/off with this
 #include "ManagerOpenGLState.h" //We can change OpenGL State attributes with this
+#include "LZCompressor.h"
+#include "ManagerWindowing.h"
 #include "NetMessengerClient.h"
 #include "NetMessengerServer.h"
 #include "NetMessengerServerListener.h"
 #include "NetMessengerServerSession.h"
 #include "NetMessengerSessionContainer.h"
 #include "PhysXEngine.h"
+#include "PhysXLODManager.h"
+#include "PhysXRecorder.h"
+#include "PhysXTriggerListener.h"
+#include "PhysicsModuleWayPoints.h"
 #include "WorldList.h" //This is where we place all of our WOs
 
 //Different WO used by this module
@@ -30,12 +41,47 @@
 #include "WOSkyBox.h"
 #include "WOStaticTriangleMesh.h"
 
+#include "NetMsgClientView.h"
+#include "NetMsgClockSync.h"
+#include "NetMsgJoin.h"
 #include "NetMsgNewModel.h"
+#include "NetMsgSnapshotChunk.h"
 #include "NetMsgUpdateModel.h"
+#include "PoseWire.h"
+#include "ReplicationServer.h"
 
 using namespace Aftr;
 using namespace physx;
 
+// positive number read from aftr.conf variable name; defaultValue if it is unset, and with a
+// message if it is malformed (std::stoul/std::stof would throw from loadMap instead)
+static size_t getPositiveConfigSize(const std::string& name, size_t defaultValue)
+{
+    std::string value = ManagerEnvironmentConfiguration::getVariableValue(name);
+    if (value.empty())
+        return defaultValue;
+    unsigned long long parsed = std::strtoull(value.c_str(), nullptr, 10);
+    if (value.find_first_not_of("0123456789") != std::string::npos || parsed == 0) {
+        std::cout << "Ignoring " << name << "=" << value << ", not a positive integer; using " << defaultValue << std::endl;
+        return defaultValue;
+    }
+    return size_t(parsed);
+}
+
+static float getPositiveConfigFloat(const std::string& name, float defaultValue)
+{
+    std::string value = ManagerEnvironmentConfiguration::getVariableValue(name);
+    if (value.empty())
+        return defaultValue;
+    char* end = nullptr;
+    float parsed = std::strtof(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0' || !(parsed > 0.0f) || !std::isfinite(parsed)) {
+        std::cout << "Ignoring " << name << "=" << value << ", not a positive number; using " << defaultValue << std::endl;
+        return defaultValue;
+    }
+    return parsed;
+}
+
 GLViewPhysicsModule* GLViewPhysicsModule::New(const std::vector<std::string>& args)
 {
     GLViewPhysicsModule* glv = new GLViewPhysicsModule(args);
@@ -63,6 +109,17 @@ GLViewPhysicsModule::GLViewPhysicsModule(const std::vector<std::string>& args)
 
     physxEngine = nullptr;
     netClient = nullptr;
+    replicationServer = nullptr;
+    replicationTick = 0;
+    viewDistance = 1000.0f;
+    lastSentView = Vector(0, 0, 0);
+    snapshotID = 0;
+    nextSnapshotChunk = 0;
+    poseStreamBroken = false;
+    physxEvents.reserve(4096);
+    cameraProxy = nullptr;
+    terrain = nullptr;
+    lastClockSyncSent = 0;
 }
 
 void GLViewPhysicsModule::onCreate()
@@ -77,22 +134,36 @@ void GLViewPhysicsModule::onCreate()
         this->pe->setGravityScalar(Aftr::GRAVITY);
     }
     this->setActorChaseType(STANDARDEZNAV); //Default is STANDARDEZNAV mode
+
     //this->setNumPhysicsStepsPerRender( 0 ); //pause physics engine on start up; will remain paused till set to 1
 }
 
 GLViewPhysicsModule::~GLViewPhysicsModule()
 {
     //Implicitly calls GLView::~GLView()
-    if (physxEngine != nullptr)
+    if (physxEngine != nullptr) {
+        // LOD proxies have to be released while PhysX is still around, but not while it simulates
+        physxEngine->stopThread();
+        physxLOD = nullptr;
         physxEngine->shutdown();
+    }
 }
 
 void GLViewPhysicsModule::updateWorld()
 {
+    if (netClient != nullptr)
+        recordDisplayLatency();
+
     GLView::updateWorld(); //Just call the parent's update world first.
         //If you want to add additional functionality, do it after
         //this call.
 
+    if (netClient != nullptr) {
+        sendClientView();
+        sendClockSync();
+        instantiatePendingModels();
+    }
+
     if (physxEngine != nullptr) {
         using namespace std::chrono;
 
@@ -102,7 +173,188 @@ void GLViewPhysicsModule::updateWorld()
         float dt = duration_cast<duration<float>>(now - last_time).count();
         last_time = now;
 
+        if (cameraProxy != nullptr) {
+            Vector c = cam->getPosition();
+            PxRigidDynamic* proxy = cameraProxy;
+            physxEngine->execute([proxy, c](PhysXEngine&) { proxy->setKinematicTarget(PxTransform(PxVec3(c.x, c.y, c.z))); });
+        }
+
+        if (physxLOD != nullptr)
+            updatePhysicsLOD();
+
+        ++replicationTick;
         physxEngine->updateSimulation(dt);
+        encodeReplicatedBodies();
+
+        // grab every event generated by this step in one batch
+        physxEngine->getEventQueue().drain(physxEvents);
+        handlePhysXEvents();
+
+        replicateTick();
+    }
+}
+
+void GLViewPhysicsModule::replicateTick()
+{
+    if (replicationServer == nullptr)
+        return;
+
+    replicationServer->replicate(replicatedBodies, replicationTick);
+    replicationServer->tick();
+}
+
+void GLViewPhysicsModule::encodeReplicatedBodies()
+{
+    if (replicationServer == nullptr)
+        return;
+
+    // encode once, every session copies the record if it decides to send it
+    const PhysXPoseStore& store = physxEngine->getPoseStore();
+    for (unsigned int physxID : store.getDirtyIDs()) {
+        unsigned int id = physxID < modelIDs.size() ? modelIDs[physxID] : unsigned(NO_MODEL_ID);
+        if (id == NO_MODEL_ID)
+            continue;
+
+        const PxVec3& p = store.getPosition(physxID);
+        ReplicatedBody& body = replicatedBodies[id];
+        body.valid = true;
+        body.lastUpdateTick = replicationTick;
+        body.position = Vector(p.x, p.y, p.z);
+        body.speed = store.getLinearVelocity(physxID).magnitude();
+        NetMsgUpdateModel::encodeUpdate(body.record, id, WOPhysXActor::toDisplayMatrix(store.getRotation(physxID)), body.position);
+    }
+}
+
+void GLViewPhysicsModule::updatePhysicsLOD()
+{
+    std::vector<Vector> views;
+    views.push_back(cam->getPosition());
+    if (replicationServer != nullptr)
+        replicationServer->getViews(views);
+
+    std::vector<PxVec3> viewers;
+    viewers.reserve(views.size());
+    for (const Vector& v : views) {
+        viewers.push_back(PxVec3(v.x, v.y, v.z));
+    }
+
+    std::shared_ptr<PhysXLODManager> lod = physxLOD;
+    physxEngine->execute([lod, viewers](PhysXEngine& engine) { lod->update(engine, viewers); });
+}
+
+void GLViewPhysicsModule::sendClientView()
+{
+    // only worth a message once the camera has actually moved
+    Vector position = cam->getPosition();
+    float dx = position.x - lastSentView.x;
+    float dy = position.y - lastSentView.y;
+    float dz = position.z - lastSentView.z;
+    if (dx * dx + dy * dy + dz * dz < 1.0f)
+        return;
+
+    NetMsgClientView msg;
+    msg.host = clientHost;
+    msg.port = clientPort;
+    msg.position = position;
+    msg.viewDistance = viewDistance;
+    netClient->sendNetMsgSynchronousTCP(msg);
+    lastSentView = position;
+}
+
+void GLViewPhysicsModule::sendClockSync()
+{
+    uint64_t now = getReplicationClock();
+    if (lastClockSyncSent != 0 && now - lastClockSyncSent < 1000000)
+        return;
+
+    NetMsgClockSync msg;
+    msg.host = clientHost;
+    msg.port = clientPort;
+    msg.clientSend = now;
+    netClient->sendNetMsgSynchronousTCP(msg);
+    lastClockSyncSent = now;
+}
+
+void GLViewPhysicsModule::receiveClockSync(const NetMsgClockSync& msg)
+{
+    if (replicationServer != nullptr) {
+        // answered through the client's session, which stamps serverSend right before sending
+        ReplicationSession* session = replicationServer->getSession(msg.host, msg.port);
+        if (session == nullptr)
+            return;
+        std::shared_ptr<NetMsgClockSync> answer = std::make_shared<NetMsgClockSync>(msg);
+        answer->serverReceive = msg.received;
+        session->enqueue(answer, msg.host.size() + msg.port.size() + 3 * sizeof(uint64_t), false);
+    } else if (netClient != nullptr && msg.serverReceive != 0) {
+        clockSync.addSample(msg.clientSend, msg.serverReceive, msg.serverSend, msg.received);
+    }
+}
+
+void GLViewPhysicsModule::recordUpdateLatency(const NetMsgUpdateModel& msg)
+{
+    uint64_t now = getReplicationClock();
+    applyLatency.add(int64_t(now - msg.received));
+
+    uint64_t queued = 0;
+    if (clockSync.isSynced()) {
+        transitLatency.add(int64_t(msg.received - clockSync.toLocal(msg.sent)));
+        queued = clockSync.toLocal(msg.created);
+    }
+    undisplayedUpdates.push_back(std::make_pair(now, queued));
+}
+
+void GLViewPhysicsModule::recordDisplayLatency()
+{
+    uint64_t now = getReplicationClock();
+    for (const auto& update : undisplayedUpdates) {
+        displayLatency.add(int64_t(now - update.first));
+        if (update.second != 0)
+            viewAgeLatency.add(int64_t(now - update.second));
+    }
+    undisplayedUpdates.clear();
+}
+
+void GLViewPhysicsModule::printReplicationLatency() const
+{
+    std::cout << "Replication latency | clock offset " << clockSync.getOffset() / 1000.0 << " ms | round trip "
+              << clockSync.getRoundTrip() / 1000.0 << " ms" << (clockSync.isSynced() ? "" : " (not synced yet)") << std::endl;
+
+    auto print = [](const LatencyHistogram& h, const char* name) {
+        std::cout << "  ";
+        h.print(std::cout, name);
+        std::cout << std::endl;
+    };
+    print(transitLatency, "transit");
+    print(applyLatency, "wait to apply");
+    print(displayLatency, "apply to display");
+    print(viewAgeLatency, "queued to display");
+}
+
+void GLViewPhysicsModule::handlePhysXEvents()
+{
+    for (const PhysXEvent& e : physxEvents) {
+        switch (e.type) {
+        case PHYSX_EVENT_TYPE::peTRIGGER_ENTER:
+            if (PhysXTriggerListener* listener = physxEngine->getTriggerOwner(e.a))
+                listener->onPhysXTriggerEnter(static_cast<const PhysXUserData*>(e.b));
+            break;
+        case PHYSX_EVENT_TYPE::peTRIGGER_EXIT:
+            if (PhysXTriggerListener* listener = physxEngine->getTriggerOwner(e.a))
+                listener->onPhysXTriggerExit(static_cast<const PhysXUserData*>(e.b));
+            break;
+        case PHYSX_EVENT_TYPE::peCONTACT:
+            // recently collided bodies get replicated with a higher priority
+            for (const void* actor : { e.a, e.b }) {
+                const PhysXUserData* data = static_cast<const PhysXUserData*>(actor);
+                if (data == nullptr || data->type != PHYSX_USER_DATA_TYPE::pudBODY || data->id >= modelIDs.size())
+                    continue;
+                if (modelIDs[data->id] != NO_MODEL_ID)
+                    replicatedBodies[modelIDs[data->id]].lastCollisionTick = replicationTick;
+            }
+            break;
+        default:
+            break;
+        }
     }
 }
 
@@ -118,6 +370,23 @@ void GLViewPhysicsModule::onMouseDown(const SDL_MouseButtonEvent& e)
 
 void GLViewPhysicsModule::onMouseDownSelection(unsigned int x, unsigned int y, Camera& cam)
 {
+    if (physxEngine != nullptr) {
+        // pick with one raycast against the cooked terrain instead of the GL selection read-back
+        PxVec3 origin, dir;
+        computePickRay(x, y, cam, origin, dir);
+
+        // the query has to run where the scene lives, the spawn back on this thread
+        physxEngine->execute([this, origin, dir](PhysXEngine& engine) {
+            PhysXQueryHit hit;
+            if (engine.raycast(origin, dir, ManagerOpenGLState::GL_CLIPPING_PLANE, hit, pcgSTATIC)) {
+                Vector pos = Vector(hit.position.x, hit.position.y, hit.position.z) + Vector(0, 0, 15);
+
+                engine.runOnGameThread([this, pos]() { spawnNewModel(teapotPath, Vector(2, 2, 2), pos); });
+            }
+        });
+        return;
+    }
+
     GLView::onMouseDownSelection(x, y, cam);
 
     if (getLastSelectedCoordinate() != nullptr) {
@@ -127,6 +396,28 @@ void GLViewPhysicsModule::onMouseDownSelection(unsigned int x, unsigned int y, C
     }
 }
 
+void GLViewPhysicsModule::computePickRay(unsigned int x, unsigned int y, Camera& cam, PxVec3& origin, PxVec3& unitDir) const
+{
+    Vector p = cam.getPosition();
+    Vector l = cam.getCameraLookDirection();
+    Vector n = cam.getNormalDirection();
+    PxVec3 look = PxVec3(l.x, l.y, l.z).getNormalized();
+    PxVec3 up = PxVec3(n.x, n.y, n.z).getNormalized();
+    PxVec3 right = look.cross(up).getNormalized();
+
+    // map the pixel to [-1, 1] normalized device coordinates (window y grows downwards)
+    float width = float(ManagerWindowing::getWindowWidth());
+    float height = float(ManagerWindowing::getWindowHeight());
+    float ndcX = 2.0f * (float(x) + 0.5f) / width - 1.0f;
+    float ndcY = 1.0f - 2.0f * (float(y) + 0.5f) / height;
+
+    float tanHalfHoriz = std::tan(cam.getCameraHorizontalFOVDeg() * 0.5f * Aftr::DEGtoRAD);
+    float tanHalfVert = tanHalfHoriz / cam.getCameraAspectRatioWidthToHeight();
+
+    origin = PxVec3(p.x, p.y, p.z);
+    unitDir = (look + right * (ndcX * tanHalfHoriz) + up * (ndcY * tanHalfVert)).getNormalized();
+}
+
 void GLViewPhysicsModule::onMouseUp(const SDL_MouseButtonEvent& e)
 {
     GLView::onMouseUp(e);
@@ -144,7 +435,22 @@ void GLViewPhysicsModule::onKeyDown(const SDL_KeyboardEvent& key)
         this->setNumPhysicsStepsPerRender(1);
 
     if (key.keysym.sym == SDLK_1) {
+        if (replicationServer != nullptr)
+            replicationServer->printStats();
+        if (netClient != nullptr)
+            printReplicationLatency();
+        if (physxLOD != nullptr) {
+            std::shared_ptr<PhysXLODManager> lod = physxLOD;
+            physxEngine->execute([lod](PhysXEngine&) { lod->printStats(); });
+        }
+        if (physxEngine->getNumShards() > 1)
+            physxEngine->execute([](PhysXEngine& engine) { engine.printShardStats(); });
     }
+
+    if (key.keysym.sym == SDLK_3 && isAuthoritative())
+        savePhysXScene();
+    if (key.keysym.sym == SDLK_4 && isAuthoritative())
+        loadPhysXScene();
 }
 
 void GLViewPhysicsModule::onKeyUp(const SDL_KeyboardEvent& key)
@@ -171,11 +477,30 @@ void Aftr::GLViewPhysicsModule::loadMap()
     teapotPath = ManagerEnvironmentConfiguration::getLMM() + "/models/teapot.obj";
 
     std::string port = ManagerEnvironmentConfiguration::getVariableValue("NetServerListenPort");
+    std::string recordFile = ManagerEnvironmentConfiguration::getVariableValue("PhysXRecordFile");
     if (port == "12683") {
-        physxEngine = std::make_shared<PhysXEngine>();
-        netClient = std::shared_ptr<NetMessengerClient>(NetMessengerClient::New("127.0.0.1", "12682"));
+        PhysXEngineDesc desc;
+        desc.enhancedDeterminism = !recordFile.empty();
+        desc.numShards = unsigned(getPositiveConfigSize("PhysXShards", 1));
+        desc.shardWidth = getPositiveConfigFloat("PhysXShardWidth", desc.shardWidth);
+        physxEngine = std::make_shared<PhysXEngine>(desc);
+        if (!recordFile.empty())
+            physxEngine->setRecorder(std::make_shared<PhysXRecorder>(recordFile, physxEngine->getNumShards(), desc.shardWidth));
+
+        // clients join through NetMsgJoin, see addClientSession
+        std::string compression = ManagerEnvironmentConfiguration::getVariableValue("ReplicationCompression");
+        replicationServer = std::make_shared<ReplicationServer>(getPositiveConfigSize("ReplicationMaxQueuedBytes", 256 * 1024), 120,
+            getPositiveConfigSize("ReplicationBytesPerTick", 16 * 1024), compression == "1");
     } else {
-        netClient = std::shared_ptr<NetMessengerClient>(NetMessengerClient::New("127.0.0.1", "12683"));
+        std::string serverHost = ManagerEnvironmentConfiguration::getVariableValue("ReplicationServerHost");
+        std::string host = ManagerEnvironmentConfiguration::getVariableValue("ReplicationClientHost");
+        clientHost = host.empty() ? "127.0.0.1" : host;
+        clientPort = port;
+        viewDistance = getPositiveConfigFloat("ReplicationViewDistance", float(ManagerOpenGLState::GL_CLIPPING_PLANE));
+        netClient = std::shared_ptr<NetMessengerClient>(NetMessengerClient::New(serverHost.empty() ? "127.0.0.1" : serverHost, "12683"));
+        assetPrefetcher = std::unique_ptr<AssetPrefetcher>(new AssetPrefetcher());
+
+        requestSnapshot();
     }
 
     //SkyBox Textures readily available
@@ -200,51 +525,448 @@ void Aftr::GLViewPhysicsModule::loadMap()
     wo->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
     worldLst->push_back(wo);
 
-    WOPhysXActor* mountain = WOStaticTriangleMesh::New(mountainPath, Vector(1, 1, 1), MESH_SHADING_TYPE::mstFLAT);
-    mountain->setPosition(Vector(0, 0, 18));
-    mountain->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
-    worldLst->push_back(mountain);
+    // restarting from a checkpoint happens before anything else is put into the scene: the
+    // terrain below takes over its saved actor instead of being cooked again, and every saved
+    // teapot is recreated. The physics thread isn't running yet, so this loads right here.
+    sceneFile = ManagerEnvironmentConfiguration::getVariableValue("PhysXSceneFile");
+    if (sceneFile.empty())
+        sceneFile = "physx_scene.bin";
+    std::vector<PhysXSceneEntry> restored;
+    if (physxEngine != nullptr && ManagerEnvironmentConfiguration::getVariableValue("PhysXSceneRestore") == "1") {
+        if (physxEngine->loadScene(sceneFile, restored)) {
+            std::cout << "Restored PhysX scene " << sceneFile << std::endl;
+            restoreModels(restored);
+        } else {
+            std::cout << "Failed to restore PhysX scene " << sceneFile << ", starting from scratch" << std::endl;
+        }
+    }
+
+    terrain = WOStaticTriangleMesh::New(mountainPath, Vector(1, 1, 1), MESH_SHADING_TYPE::mstFLAT);
+    terrain->setPosition(Vector(0, 0, 18));
+    terrain->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
+    worldLst->push_back(terrain);
     if (physxEngine != nullptr) {
-        mountain->setPhysXEngine(physxEngine);
+        std::string terrainFile = terrain->getModel()->getModelDataShared()->getFileName();
+        auto saved = std::find_if(restored.begin(), restored.end(),
+            [&terrainFile](const PhysXSceneEntry& entry) { return entry.isStatic && entry.fileName == terrainFile; });
+        if (saved != restored.end())
+            terrain->adoptPhysXActor(physxEngine, saved->id);
+        else
+            terrain->setPhysXEngine(physxEngine);
+        cameraProxy = physxEngine->createKinematicSphere(PxVec3(50, 50, 50), 1.0f);
     }
+
+    createPhysicsModuleWayPoints();
+
+    // LOD transitions change the simulation but aren't recorded, so a recording would not replay
+    if (physxEngine != nullptr && ManagerEnvironmentConfiguration::getVariableValue("PhysXLOD") == "1") {
+        if (physxEngine->getRecorder() != nullptr)
+            std::cout << "Ignoring PhysXLOD=1, physics LOD is off while PhysXRecordFile is set" << std::endl;
+        else
+            physxLOD = std::make_shared<PhysXLODManager>();
+    }
+
+    // from here on the scene may only be touched through PhysXEngine::execute; 0 (unset or
+    // malformed) keeps stepping physics on the game thread
+    float physicsHz = getPositiveConfigFloat("PhysXThreadHz", 0.0f);
+    if (physxEngine != nullptr && physicsHz > 0.0f)
+        physxEngine->startThread(physicsHz);
+}
+
+void GLViewPhysicsModule::createPhysicsModuleWayPoints()
+{
+    WayPointParametersBase params(this);
+    params.frequency = 5000;
+    params.useCamera = true;
+    params.visible = true;
+    WOWP1* wayPt = WOWP1::New(params, 3);
+    wayPt->setPosition(Vector(50, 0, 40));
+    worldLst->push_back(wayPt);
+
+    // on the simulating instance the trigger test is done by the PhysX broadphase
+    if (physxEngine != nullptr)
+        wayPt->setPhysXEngine(physxEngine);
 }
 
 void GLViewPhysicsModule::spawnNewModel(const std::string& path, const Vector& scale, const Vector& position, bool sendMsg)
 {
-    WOPhysXActor* model = WODynamicConvexMesh::New(path, scale, MESH_SHADING_TYPE::mstFLAT);
-    model->setPosition(position);
-    model->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
-    worldLst->push_back(model);
-    models.push_back(model);
+    NetMsgNewModel msg;
+    msg.path = path;
+    msg.scale = scale;
+    msg.position = position;
+
+    if (!isAuthoritative() && sendMsg) {
+        // the model shows up once the simulating instance replicates it back,
+        // so every client agrees on model ids
+        if (netClient != nullptr)
+            netClient->sendNetMsgSynchronousTCP(msg);
+        return;
+    }
 
-    if (sendMsg) {
-        // send msg to other instance
-        NetMsgNewModel msg;
-        msg.path = path;
-        msg.scale = scale;
-        msg.position = position;
-        netClient->sendNetMsgSynchronousTCP(msg);
+    unsigned int id = static_cast<unsigned int>(models.size());
+    WOPhysXActor* model = addModel(id, path, scale, position);
+
+    if (sendMsg && replicationServer != nullptr) {
+        // spawns must never be dropped, updates queued after them rely on the id
+        msg.id = id;
+        replicationServer->broadcast(std::make_shared<NetMsgNewModel>(msg), path.size() + 7 * sizeof(float), false);
     }
 
     if (physxEngine != nullptr) {
-        unsigned int id = static_cast<unsigned int>(models.size()) - 1;
-
         // setup model's physics
         model->setPhysXEngine(physxEngine);
+        trackReplicatedModel(id, model, path, scale);
+    }
+}
+
+void GLViewPhysicsModule::trackReplicatedModel(unsigned int id, WOPhysXActor* model, const std::string& path, const Vector& scale)
+{
+    replicatedBodies.resize(models.size());
+    replicatedBodies[id].path = path;
+    replicatedBodies[id].scale = scale;
+    unsigned int physxID = model->getPhysXID();
+    if (physxID >= modelIDs.size())
+        modelIDs.resize(physxID + 1, unsigned(NO_MODEL_ID));
+    modelIDs[physxID] = id;
+}
+
+void GLViewPhysicsModule::savePhysXScene()
+{
+    // which model every actor belongs to, read here since the save may run on the physics thread
+    std::shared_ptr<std::vector<PhysXSceneEntry>> owners = std::make_shared<std::vector<PhysXSceneEntry>>();
+    std::vector<WOPhysXActor*> bodies(models);
+    bodies.push_back(terrain);
+    for (WOPhysXActor* wo : bodies) {
+        if (wo == nullptr)
+            continue;
+        ModelDataShared* modelData = wo->getModel()->getModelDataShared();
+        Vector scale = modelData->getInitialScaleFactor();
+        unsigned int id = wo->getPhysXID();
+        if (id >= owners->size())
+            owners->resize(id + 1);
+        (*owners)[id].fileName = modelData->getFileName();
+        (*owners)[id].scale = PxVec3(scale.x, scale.y, scale.z);
+    }
+
+    std::string file = sceneFile;
+    std::shared_ptr<PhysXLODManager> lod = physxLOD;
+    physxEngine->execute([file, lod, owners](PhysXEngine& engine) {
+        using namespace std::chrono;
+        auto before = steady_clock::now();
+        // the checkpoint holds full fidelity bodies, LOD re-evaluates them over the next updates
+        if (lod != nullptr)
+            lod->reset(engine);
+        bool saved = engine.saveScene(file, *owners);
+        double ms = duration<double, std::milli>(steady_clock::now() - before).count();
+        std::cout << (saved ? "Saved PhysX scene " : "Failed to save PhysX scene ") << file << " in " << ms << " ms" << std::endl;
+    });
+}
 
-        model->setPhysXUpdateCallback([this, id, model]() {
-            // send update message to other instance
-            NetMsgUpdateModel msg;
+void GLViewPhysicsModule::loadPhysXScene()
+{
+    std::string file = sceneFile;
+    std::shared_ptr<PhysXLODManager> lod = physxLOD;
+    physxEngine->execute([this, file, lod](PhysXEngine& engine) {
+        using namespace std::chrono;
+        auto before = steady_clock::now();
+        // levels belong to the replaced actors, and their proxies must be gone before the
+        // scene they may have come from is released
+        if (lod != nullptr)
+            lod->reset(engine);
+        std::shared_ptr<std::vector<PhysXSceneEntry>> restored = std::make_shared<std::vector<PhysXSceneEntry>>();
+        bool loaded = engine.loadScene(file, *restored);
+        double ms = duration<double, std::milli>(steady_clock::now() - before).count();
+        std::cout << (loaded ? "Loaded PhysX scene " : "Failed to load PhysX scene ") << file << " in " << ms << " ms" << std::endl;
+        if (loaded)
+            engine.runOnGameThread([this, restored]() { restoreModels(*restored); });
+    });
+}
+
+void GLViewPhysicsModule::restoreModels(const std::vector<PhysXSceneEntry>& restored)
+{
+    for (const PhysXSceneEntry& entry : restored) {
+        // WOs that still own their id carry on with the restored actor; only spawned
+        // models come and go, loadMap hands the terrain its saved actor
+        if (physxEngine->getBodyOwner(entry.id) != nullptr || entry.isStatic || entry.fileName.empty())
+            continue;
+
+        Vector scale(entry.scale.x, entry.scale.y, entry.scale.z);
+        unsigned int id = static_cast<unsigned int>(models.size());
+        WOPhysXActor* model = addModel(id, entry.fileName, scale, Vector(entry.pose.p.x, entry.pose.p.y, entry.pose.p.z));
+        model->applyPhysXPose(entry.pose.p, entry.pose.q);
+        model->adoptPhysXActor(physxEngine, entry.id);
+        trackReplicatedModel(id, model, entry.fileName, scale);
+
+        if (replicationServer != nullptr) {
+            NetMsgNewModel msg;
             msg.id = id;
-            msg.displayMatrix = model->getDisplayMatrix();
+            msg.path = entry.fileName;
+            msg.scale = scale;
             msg.position = model->getPosition();
-            netClient->sendNetMsgSynchronousTCP(msg);
-        });
+            replicationServer->broadcast(std::make_shared<NetMsgNewModel>(msg), msg.path.size() + 7 * sizeof(float), false);
+        }
+    }
+}
+
+WOPhysXActor* GLViewPhysicsModule::addModel(unsigned int id, const std::string& path, const Vector& scale, const Vector& position)
+{
+    if (id < models.size() && models[id] != nullptr)
+        return models[id];
+
+    WOPhysXActor* model = WODynamicConvexMesh::New(path, scale, MESH_SHADING_TYPE::mstFLAT);
+    model->setPosition(position);
+    model->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
+    worldLst->push_back(model);
+
+    // ids can arrive out of order on clients (spawns racing a late join snapshot)
+    if (id >= models.size())
+        models.resize(id + 1, nullptr);
+    models[id] = model;
+
+    return model;
+}
+
+void GLViewPhysicsModule::queueModel(unsigned int id, const std::string& path, const Vector& scale, const Vector& position)
+{
+    if ((id < models.size() && models[id] != nullptr) || pendingModels.count(id) != 0)
+        return;
+
+    // another instance already paid for loading this path
+    if (loadedPaths.count(path) != 0) {
+        addModel(id, path, scale, position);
+        return;
+    }
+
+    PendingModel& pending = pendingModels[id];
+    pending.path = path;
+    pending.scale = scale;
+    pending.position = position;
+    pending.hasPose = false;
+    pending.placeholder = takePlaceholder(position);
+    pendingOrder.push_back(id);
+    assetPrefetcher->request(path);
+}
+
+void GLViewPhysicsModule::instantiatePendingModels()
+{
+    // the prefetcher only saves the disk reads, loading an uncached path still parses it on
+    // this thread, so only do one per frame; models sharing an already loaded path are cheap
+    // and all get created right away
+    bool loadedPath = false;
+    auto keep = pendingOrder.begin();
+    for (unsigned int id : pendingOrder) {
+        PendingModel& pending = pendingModels[id];
+        bool cached = loadedPaths.count(pending.path) != 0;
+        if (!cached && (loadedPath || !assetPrefetcher->isReady(pending.path))) {
+            *keep++ = id;
+            continue;
+        }
+        if (!cached) {
+            loadedPath = true;
+            loadedPaths.insert(pending.path);
+        }
+
+        addModel(id, pending.path, pending.scale, pending.position);
+        if (pending.hasPose)
+            applyPose(pending.pose);
+        pending.placeholder->isVisible = false;
+        freePlaceholders.push_back(pending.placeholder);
+        pendingModels.erase(id);
     }
+    pendingOrder.erase(keep, pendingOrder.end());
 }
 
-void GLViewPhysicsModule::updateModel(unsigned int id, const Mat4& displayMatrix, const Vector& position)
+WO* GLViewPhysicsModule::takePlaceholder(const Vector& position)
 {
-    models.at(id)->getModel()->setDisplayMatrix(displayMatrix);
-    models.at(id)->setPosition(position);
+    WO* placeholder;
+    if (!freePlaceholders.empty()) {
+        placeholder = freePlaceholders.back();
+        freePlaceholders.pop_back();
+    } else {
+        // a small shared-media cube, only the first one is parsed
+        placeholder = WO::New(ManagerEnvironmentConfiguration::getSMM() + "/models/cube4x4x4redShinyPlastic_pp.wrl", Vector(0.5f, 0.5f, 0.5f), MESH_SHADING_TYPE::mstFLAT);
+        placeholder->renderOrderType = RENDER_ORDER_TYPE::roOPAQUE;
+        worldLst->push_back(placeholder);
+    }
+    placeholder->setPosition(position);
+    placeholder->isVisible = true;
+    return placeholder;
+}
+
+void GLViewPhysicsModule::addClientSession(const std::string& host, const std::string& port)
+{
+    if (replicationServer == nullptr)
+        return;
+
+    ReplicationSession* session = replicationServer->addSession(host, port);
+
+    size_t rawSize = 0;
+    std::shared_ptr<const std::string> snapshot = buildSnapshot(rawSize);
+    session->sendSnapshot(snapshot, rawSize, replicationTick);
+}
+
+std::shared_ptr<const std::string> GLViewPhysicsModule::buildSnapshot(size_t& rawSize)
+{
+    auto append = [](std::string& out, const void* data, size_t size) {
+        out.append(static_cast<const char*>(data), size);
+    };
+
+    std::string raw;
+    unsigned int count = 0;
+    append(raw, &count, sizeof(count));
+    for (unsigned int id = 0; id < models.size(); ++id) {
+        if (models[id] == nullptr || id >= replicatedBodies.size())
+            continue;
+
+        const ReplicatedBody& body = replicatedBodies[id];
+        unsigned int length = static_cast<unsigned int>(body.path.size());
+        float scale[3] = { body.scale.x, body.scale.y, body.scale.z };
+        char record[NetMsgUpdateModel::UPDATE_SIZE];
+        NetMsgUpdateModel::encodeUpdate(record, id, models[id]->getDisplayMatrix(), models[id]->getPosition());
+
+        append(raw, &id, sizeof(id));
+        append(raw, &length, sizeof(length));
+        raw.append(body.path);
+        append(raw, scale, sizeof(scale));
+        append(raw, record, sizeof(record));
+        ++count;
+    }
+    std::memcpy(&raw[0], &count, sizeof(count));
+
+    std::string compressed;
+    LZCompressor::compress(raw.data(), raw.size(), compressed);
+    rawSize = raw.size();
+    return std::make_shared<const std::string>(std::move(compressed));
+}
+
+void GLViewPhysicsModule::receiveSnapshotChunk(const NetMsgSnapshotChunk& chunk)
+{
+    if (chunk.index == 0) {
+        // a snapshot starts every session, so the session's compression context starts over too
+        poseDecoder.reset();
+        poseStreamBroken = false;
+        snapshotChunks.clear();
+        snapshotID = chunk.snapshotID;
+        nextSnapshotChunk = 0;
+    }
+    // chunks of an older snapshot or a gap mean this snapshot can't be completed
+    if (chunk.snapshotID != snapshotID || chunk.index != nextSnapshotChunk)
+        return;
+
+    snapshotChunks.append(chunk.data);
+    ++nextSnapshotChunk;
+
+    if (nextSnapshotChunk == chunk.numChunks) {
+        std::string raw;
+        if (LZCompressor::decompress(snapshotChunks.data(), snapshotChunks.size(), chunk.rawSize, raw))
+            applySnapshot(raw);
+        else
+            std::cout << "Received a corrupt world snapshot" << std::endl;
+        snapshotChunks = std::string();
+    }
+}
+
+void GLViewPhysicsModule::applySnapshot(const std::string& raw)
+{
+    const char* p = raw.data();
+    const char* end = p + raw.size();
+    auto read = [&p, end](void* out, size_t size) {
+        if (size_t(end - p) < size)
+            return false;
+        std::memcpy(out, p, size);
+        p += size;
+        return true;
+    };
+
+    unsigned int count = 0;
+    if (!read(&count, sizeof(count)))
+        return;
+
+    unsigned int applied = 0;
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int id = 0, length = 0;
+        float scale[3];
+        if (!read(&id, sizeof(id)) || !read(&length, sizeof(length)) || size_t(end - p) < length)
+            break;
+        std::string path(p, length);
+        p += length;
+        if (!read(scale, sizeof(scale)) || size_t(end - p) < NetMsgUpdateModel::UPDATE_SIZE)
+            break;
+
+        PoseWire w;
+        PoseWire::decode(p, w);
+        queueModel(id, path, Vector(scale[0], scale[1], scale[2]), Vector(w.position[0], w.position[1], w.position[2]));
+        applyPose(w);
+        p += NetMsgUpdateModel::UPDATE_SIZE;
+        ++applied;
+    }
+
+    std::cout << "Applied world snapshot with " << applied << " models" << std::endl;
+}
+
+void GLViewPhysicsModule::setClientView(const std::string& host, const std::string& port, const Vector& position, float viewDistance)
+{
+    if (replicationServer == nullptr)
+        return;
+
+    ReplicationSession* session = replicationServer->getSession(host, port);
+    if (session != nullptr)
+        session->setView(position, viewDistance);
+}
+
+void GLViewPhysicsModule::applyCompressedPoses(const char* data, size_t size, unsigned int count)
+{
+    // every packet after a lost one is XORed against records we never saw
+    if (poseStreamBroken)
+        return;
+
+    if (poseDecoder.decompress(data, size, count, poseDecodeScratch)) {
+        applyPoses(poseDecodeScratch.data(), count);
+    } else {
+        // the session's context has moved on past this packet, ours can't follow
+        std::cout << "Received corrupt compressed model updates, requesting a fresh snapshot" << std::endl;
+        poseStreamBroken = true;
+        requestSnapshot();
+    }
+}
+
+void GLViewPhysicsModule::requestSnapshot()
+{
+    // ask the simulating instance to start replicating to our listen port
+    NetMsgJoin msg;
+    msg.host = clientHost;
+    msg.port = clientPort;
+    netClient->sendNetMsgSynchronousTCP(msg);
+}
+
+void GLViewPhysicsModule::applyPoses(const char* records, unsigned int count)
+{
+    PoseWire w;
+    for (unsigned int n = 0; n < count; ++n, records += sizeof(PoseWire)) {
+        PoseWire::decode(records, w);
+        applyPose(w);
+    }
+}
+
+void GLViewPhysicsModule::applyPose(const PoseWire& w)
+{
+    if (w.id >= models.size() || models[w.id] == nullptr) {
+        // keep the newest pose of models that are still loading; other unknown ids
+        // belong to models we haven't heard of yet, the snapshot or spawn will place them
+        auto pending = pendingModels.find(w.id);
+        if (pending != pendingModels.end()) {
+            pending->second.pose = w;
+            pending->second.hasPose = true;
+            pending->second.placeholder->setPosition(w.position[0], w.position[1], w.position[2]);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            poseScratch[i * 4 + j] = w.rotation[i * 3 + j];
+        }
+    }
+    models[w.id]->getModel()->setDisplayMatrix(poseScratch);
+    models[w.id]->setPosition(w.position[0], w.position[1], w.position[2]);
 }
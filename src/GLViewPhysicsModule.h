@@ -1,13 +1,25 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "AssetPrefetcher.h"
 #include "GLView.h"
+#include "PhysXEventQueue.h"
+#include "PoseStreamCompressor.h"
+#include "ReplicationLatency.h"
+#include "ReplicationServer.h"
 
 namespace Aftr {
 class Camera;
 class NetMessengerClient;
+class NetMsgClockSync;
+class NetMsgSnapshotChunk;
+class NetMsgUpdateModel;
 class PhysXEngine;
+class PhysXLODManager;
+struct PhysXSceneEntry;
 class WOPhysXActor;
 
 /**
@@ -35,17 +47,104 @@ public:
     virtual void onMouseMove(const SDL_MouseMotionEvent& e);
     virtual void onKeyDown(const SDL_KeyboardEvent& key);
     virtual void onKeyUp(const SDL_KeyboardEvent& key);
+    /// On the simulating instance, spawns a model and (if sendMsg) replicates it to every client.
+    /// On a client, sendMsg asks the simulating instance to spawn it instead of spawning locally.
     void spawnNewModel(const std::string& path, const Vector& scale, const Vector& position, bool sendMsg = true);
-    void updateModel(unsigned int id, const Mat4& displayMatrix, const Vector& position);
+    /// Creates the model with the given id locally, without physics or replication
+    WOPhysXActor* addModel(unsigned int id, const std::string& path, const Vector& scale, const Vector& position);
+    /// Client side, creates the model once the OS has its files cached; a placeholder stands in
+    /// until then and pose updates that arrive in the meantime are applied when it appears
+    void queueModel(unsigned int id, const std::string& path, const Vector& scale, const Vector& position);
+    /// Applies count consecutive PoseWire records to their models
+    void applyPoses(const char* records, unsigned int count);
+    void applyPose(const PoseWire& pose); ///< Places the model, or keeps the pose if the model is still loading
+    /// Decompresses count records sent by our session's PoseStreamCompressor and applies them
+    void applyCompressedPoses(const char* data, size_t size, unsigned int count);
+    void receiveSnapshotChunk(const NetMsgSnapshotChunk& chunk); ///< Client side, late join snapshot
+    /// Client side, (re)joins the simulating instance, which replaces our session with a fresh one
+    /// that starts with a snapshot
+    void requestSnapshot();
+    /// Client side, adds an applied update's transit and wait times to the latency histograms
+    void recordUpdateLatency(const NetMsgUpdateModel& msg);
+    /// Answers a client's clock sync request, or on the client takes a sample from the answer
+    void receiveClockSync(const NetMsgClockSync& msg);
+    void addClientSession(const std::string& host, const std::string& port); ///< Starts replicating to a client
+    void setClientView(const std::string& host, const std::string& port, const Vector& position, float viewDistance);
+    bool isAuthoritative() const { return physxEngine != nullptr; } ///< True on the instance running the simulation
 
 protected:
     GLViewPhysicsModule(const std::vector<std::string>& args);
     virtual void onCreate();
+    void createPhysicsModuleWayPoints();
+    /// Builds a world space ray through window pixel (x, y) of cam
+    void computePickRay(unsigned int x, unsigned int y, Camera& cam, physx::PxVec3& origin, physx::PxVec3& unitDir) const;
+    void handlePhysXEvents(); ///< Dispatches the events drained from the PhysXEngine this frame
+    void encodeReplicatedBodies(); ///< Simulating side, encodes the poses the last physics update changed
+    void replicateTick(); ///< Queues this tick's model updates for every session
+    void updatePhysicsLOD(); ///< Re-evaluates physics LOD against our camera and every client's view
+    void sendClientView(); ///< Client side, tells the simulating instance where our camera is
+    void sendClockSync(); ///< Client side, starts a clock sync exchange about once a second
+    void recordDisplayLatency(); ///< Client side, called once the updates applied last frame have been drawn
+    void printReplicationLatency() const; ///< Client side, prints the latency histograms
+    std::shared_ptr<const std::string> buildSnapshot(size_t& rawSize); ///< Compressed snapshot of every model
+    void applySnapshot(const std::string& raw); ///< Client side, creates and places every model in the snapshot
+    void instantiatePendingModels(); ///< Client side, creates queued models that are ready, at most one uncached path per frame
+    WO* takePlaceholder(const Vector& position); ///< Client side, a shown placeholder at position, reusing hidden ones
+    /// Simulating side, starts tracking a model that has physics for replication
+    void trackReplicatedModel(unsigned int id, WOPhysXActor* model, const std::string& path, const Vector& scale);
+    void savePhysXScene(); ///< Simulating side, writes a checkpoint of the PhysX scene to sceneFile
+    void loadPhysXScene(); ///< Simulating side, rolls the PhysX scene back to sceneFile
+    /// Simulating side, creates models for restored actors that no WO owns anymore
+    void restoreModels(const std::vector<PhysXSceneEntry>& restored);
 
     std::string teapotPath;
+    std::string sceneFile; ///< PhysX scene checkpoint (PhysXSceneFile in aftr.conf)
     std::shared_ptr<PhysXEngine> physxEngine;
-    std::shared_ptr<NetMessengerClient> netClient;
+    std::shared_ptr<PhysXLODManager> physxLOD; ///< Simulating side, nullptr unless PhysXLOD is set in aftr.conf
+    std::shared_ptr<NetMessengerClient> netClient; ///< Client side connection to the simulating instance
+    std::shared_ptr<ReplicationServer> replicationServer; ///< Simulating side fan-out to every client
+    std::vector<ReplicatedBody> replicatedBodies; ///< Replication state per model id, poses encoded once per change
+    Mat4 poseScratch; ///< Reused by applyPoses so decoding doesn't construct a matrix per pose
+    std::vector<unsigned int> modelIDs; ///< By PhysXEngine actor id, the replicated model id or NO_MODEL_ID; for contact events and replication
+    static const unsigned int NO_MODEL_ID = 0xFFFFFFFF;
+    unsigned int replicationTick;
+    std::string clientHost; ///< Client side, address and port the simulating instance connects back to
+    std::string clientPort;
+    float viewDistance; ///< Client side, distance beyond which models are not replicated to us
+    Vector lastSentView;
+    std::string snapshotChunks; ///< Client side, compressed snapshot received so far
+    unsigned int snapshotID;
+    unsigned int nextSnapshotChunk;
+    PoseStreamCompressor poseDecoder; ///< Client side, mirrors the context of our session on the simulating instance
+    bool poseStreamBroken; ///< Client side, poseDecoder is out of step, compressed updates are dropped until a fresh session's snapshot
+    std::string poseDecodeScratch;
     std::vector<WOPhysXActor*> models;
+    WOPhysXActor* terrain;
+
+    /// Client side, a replicated model whose files are still being read
+    struct PendingModel {
+        std::string path;
+        Vector scale;
+        Vector position;
+        bool hasPose;
+        PoseWire pose; ///< Newest pose received while loading
+        WO* placeholder; ///< Shown where the model is until it is created
+    };
+    std::unordered_map<unsigned int, PendingModel> pendingModels; ///< By model id
+    std::vector<unsigned int> pendingOrder; ///< Pending ids in arrival order
+    std::unordered_set<std::string> loadedPaths; ///< Paths Aftr has loaded once, later instances share its ModelDataShared
+    std::unique_ptr<AssetPrefetcher> assetPrefetcher; ///< Client side, warms the OS file cache for model files off the main thread
+    std::vector<WO*> freePlaceholders; ///< Hidden placeholders of pending models that have been created since
+    std::vector<PhysXEvent> physxEvents; // simulation events drained this frame
+    physx::PxRigidDynamic* cameraProxy; // kinematic sphere following the camera so it can set off triggers
+
+    ClockSync clockSync; ///< Client side, offset of the simulating instance's clock from ours
+    uint64_t lastClockSyncSent;
+    LatencyHistogram transitLatency; ///< Client side, server send to our receive (needs clock sync)
+    LatencyHistogram applyLatency; ///< Client side, our receive to the poses being applied
+    LatencyHistogram displayLatency; ///< Client side, applied to drawn
+    LatencyHistogram viewAgeLatency; ///< Client side, update queued on the server to drawn here (needs clock sync)
+    std::vector<std::pair<uint64_t, uint64_t>> undisplayedUpdates; ///< (applied, queued on our clock or 0) since the last frame
 };
 
 /** \} */
@@ -0,0 +1,143 @@
+#include "LZCompressor.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace Aftr;
+
+namespace {
+const size_t minMatch = 4;
+const size_t maxOffset = 65535;
+const unsigned int hashBits = 12;
+
+inline uint32_t read32(const char* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - hashBits);
+}
+
+void writeLength(std::string& out, size_t length)
+{
+    while (length >= 255) {
+        out.push_back(char(255));
+        length -= 255;
+    }
+    out.push_back(char(length));
+}
+
+bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length)
+{
+    unsigned char b;
+    do {
+        if (p >= end)
+            return false;
+        b = *p++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+void writeSequence(std::string& out, const char* literals, size_t numLiterals, size_t matchLength, size_t offset)
+{
+    size_t litToken = numLiterals < 15 ? numLiterals : 15;
+    size_t matchToken = 0;
+    if (matchLength > 0)
+        matchToken = matchLength - minMatch < 15 ? matchLength - minMatch : 15;
+
+    out.push_back(char((litToken << 4) | matchToken));
+    if (litToken == 15)
+        writeLength(out, numLiterals - 15);
+    out.append(literals, numLiterals);
+
+    if (matchLength > 0) {
+        out.push_back(char(offset & 0xff));
+        out.push_back(char(offset >> 8));
+        if (matchToken == 15)
+            writeLength(out, matchLength - minMatch - 15);
+    }
+}
+}
+
+void LZCompressor::compress(const char* data, size_t size, std::string& out)
+{
+    std::vector<int64_t> table(size_t(1) << hashBits, -1);
+    out.reserve(out.size() + size + size / 255 + 16);
+
+    size_t anchor = 0; // start of pending literals
+    size_t i = 0;
+    while (i + minMatch <= size) {
+        uint32_t h = hash(read32(data + i));
+        int64_t candidate = table[h];
+        table[h] = int64_t(i);
+
+        if (candidate < 0 || i - size_t(candidate) > maxOffset || read32(data + candidate) != read32(data + i)) {
+            ++i;
+            continue;
+        }
+
+        // extend the match as far as it goes
+        size_t match = size_t(candidate);
+        size_t length = minMatch;
+        while (i + length < size && data[match + length] == data[i + length]) {
+            ++length;
+        }
+
+        writeSequence(out, data + anchor, i - anchor, length, i - match);
+        i += length;
+        anchor = i;
+    }
+
+    // trailing literals
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+bool LZCompressor::decompress(const char* data, size_t size, size_t rawSize, std::string& out)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    size_t start = out.size();
+    out.reserve(start + rawSize);
+
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !readLength(p, end, numLiterals))
+            return false;
+        if (size_t(end - p) < numLiterals || out.size() - start + numLiterals > rawSize)
+            return false;
+        out.append(reinterpret_cast<const char*>(p), numLiterals);
+        p += numLiterals;
+
+        // the last sequence has no match
+        if (p == end)
+            break;
+
+        if (end - p < 2)
+            return false;
+        size_t offset = size_t(p[0]) | (size_t(p[1]) << 8);
+        p += 2;
+        size_t matchLength = token & 0x0f;
+        if (matchLength == 15 && !readLength(p, end, matchLength))
+            return false;
+        matchLength += minMatch;
+
+        size_t produced = out.size() - start;
+        if (offset == 0 || offset > produced || produced + matchLength > rawSize)
+            return false;
+        // byte by byte, matches may overlap the bytes they produce
+        size_t from = out.size() - offset;
+        for (size_t k = 0; k < matchLength; ++k) {
+            out.push_back(out[from + k]);
+        }
+    }
+
+    return out.size() - start == rawSize;
+}
\ No newline at end of file
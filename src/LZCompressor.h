@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace Aftr {
+// Small LZ77 block compressor in the spirit of LZ4: a stream of sequences, each a
+// token byte (literal length << 4 | match length - 4), optional extra length bytes
+// (255 continues), the literals, and a 2 byte little endian match offset. The last
+// sequence has literals only. Fast enough to run on the simulation thread.
+class LZCompressor {
+public:
+    // appends the compressed form of data to out
+    static void compress(const char* data, size_t size, std::string& out);
+    // decompresses exactly rawSize bytes from data into out, returns false on malformed input
+    static bool decompress(const char* data, size_t size, size_t rawSize, std::string& out);
+};
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "NetMsgClientView.h"
+
+#include <sstream>
+
+#include "GLViewPhysicsModule.h"
+#include "ManagerGLView.h"
+
+using namespace Aftr;
+
+NetMsgMacroDefinition(NetMsgClientView);
+
+NetMsgClientView::NetMsgClientView()
+{
+    host = "127.0.0.1";
+    port = "";
+    position = Vector(0, 0, 0);
+    viewDistance = 1000.0f;
+}
+
+bool NetMsgClientView::toStream(NetMessengerStreamBuffer& os) const
+{
+    os << host << port;
+    os << position.x << position.y << position.z;
+    os << viewDistance;
+
+    return true;
+}
+
+bool NetMsgClientView::fromStream(NetMessengerStreamBuffer& is)
+{
+    is >> host >> port;
+    is >> position.x >> position.y >> position.z;
+    is >> viewDistance;
+
+    return true;
+}
+
+void NetMsgClientView::onMessageArrived()
+{
+    // call setClientView in GLView
+    ManagerGLView::getGLView<GLViewPhysicsModule>()->setClientView(host, port, position, viewDistance);
+}
+
+std::string NetMsgClientView::toString() const
+{
+    std::stringstream ss;
+    ss << "ClientView | " << host << ":" << port << " | " << position << " | " << viewDistance;
+    return ss.str();
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include "NetMsg.h"
+#include "Vector.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+namespace Aftr {
+// message sent periodically by a client so the simulating instance knows what it can see
+class NetMsgClientView : public NetMsg {
+public:
+    NetMsgMacroDeclaration(NetMsgClientView);
+
+    NetMsgClientView();
+    virtual bool toStream(NetMessengerStreamBuffer& os) const;
+    virtual bool fromStream(NetMessengerStreamBuffer& is);
+    virtual void onMessageArrived();
+    virtual std::string toString() const;
+
+    std::string host; // identifies the client's session, same as in NetMsgJoin
+    std::string port;
+    Vector position; // camera position
+    float viewDistance;
+};
+}
+
+#endif
\ No newline at end of file
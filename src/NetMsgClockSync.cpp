@@ -0,0 +1,61 @@
+#include "NetMsgClockSync.h"
+
+#include <sstream>
+
+#include "GLViewPhysicsModule.h"
+#include "ManagerGLView.h"
+#include "ReplicationLatency.h"
+
+using namespace Aftr;
+
+NetMsgMacroDefinition(NetMsgClockSync);
+
+NetMsgClockSync::NetMsgClockSync()
+{
+    host = "127.0.0.1";
+    port = "";
+    clientSend = 0;
+    serverReceive = 0;
+    serverSend = 0;
+    received = 0;
+}
+
+bool NetMsgClockSync::toStream(NetMessengerStreamBuffer& os) const
+{
+    os << host << port;
+    os << getTimestampHigh(clientSend) << getTimestampLow(clientSend);
+    os << getTimestampHigh(serverReceive) << getTimestampLow(serverReceive);
+    os << getTimestampHigh(serverSend) << getTimestampLow(serverSend);
+
+    return true;
+}
+
+bool NetMsgClockSync::fromStream(NetMessengerStreamBuffer& is)
+{
+    // stamped first thing, everything after this counts as local processing
+    received = getReplicationClock();
+
+    unsigned int high = 0, low = 0;
+    is >> host >> port;
+    is >> high >> low;
+    clientSend = makeTimestamp(high, low);
+    is >> high >> low;
+    serverReceive = makeTimestamp(high, low);
+    is >> high >> low;
+    serverSend = makeTimestamp(high, low);
+
+    return true;
+}
+
+void NetMsgClockSync::onMessageArrived()
+{
+    // call receiveClockSync in GLView, which answers or takes a sample depending on the side
+    ManagerGLView::getGLView<GLViewPhysicsModule>()->receiveClockSync(*this);
+}
+
+std::string NetMsgClockSync::toString() const
+{
+    std::stringstream ss;
+    ss << "ClockSync | " << host << ":" << port << " | " << clientSend << " | " << serverReceive << " | " << serverSend;
+    return ss.str();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "NetMsg.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+namespace Aftr {
+// NTP style clock sync exchange: a client sends it with clientSend set, the simulating
+// instance answers through the client's replication session with its own receive and
+// send times filled in. Lets the client put server timestamps on its own clock.
+class NetMsgClockSync : public NetMsg {
+public:
+    NetMsgMacroDeclaration(NetMsgClockSync);
+
+    NetMsgClockSync();
+    virtual bool toStream(NetMessengerStreamBuffer& os) const;
+    virtual bool fromStream(NetMessengerStreamBuffer& is);
+    virtual void onMessageArrived();
+    virtual std::string toString() const;
+
+    std::string host; // identifies the client's session, same as in NetMsgJoin
+    std::string port;
+    uint64_t clientSend; // client clock
+    uint64_t serverReceive; // server clock, 0 in the request
+    uint64_t serverSend; // server clock, stamped by the session right before sending the answer
+    uint64_t received; // local clock when this instance read the message, not streamed
+};
+}
+
+#endif
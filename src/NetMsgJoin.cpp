@@ -0,0 +1,43 @@
+#include "NetMsgJoin.h"
+
+#include <sstream>
+
+#include "GLViewPhysicsModule.h"
+#include "ManagerGLView.h"
+
+using namespace Aftr;
+
+NetMsgMacroDefinition(NetMsgJoin);
+
+NetMsgJoin::NetMsgJoin()
+{
+    host = "127.0.0.1";
+    port = "";
+}
+
+bool NetMsgJoin::toStream(NetMessengerStreamBuffer& os) const
+{
+    os << host << port;
+
+    return true;
+}
+
+bool NetMsgJoin::fromStream(NetMessengerStreamBuffer& is)
+{
+    is >> host >> port;
+
+    return true;
+}
+
+void NetMsgJoin::onMessageArrived()
+{
+    // open a replication session back to the client
+    ManagerGLView::getGLView<GLViewPhysicsModule>()->addClientSession(host, port);
+}
+
+std::string NetMsgJoin::toString() const
+{
+    std::stringstream ss;
+    ss << "Join | " << host << ":" << port;
+    return ss.str();
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "NetMsg.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+namespace Aftr {
+// message sent by a client to the simulating instance to start receiving replication
+class NetMsgJoin : public NetMsg {
+public:
+    NetMsgMacroDeclaration(NetMsgJoin);
+
+    NetMsgJoin();
+    virtual bool toStream(NetMessengerStreamBuffer& os) const;
+    virtual bool fromStream(NetMessengerStreamBuffer& is);
+    virtual void onMessageArrived();
+    virtual std::string toString() const;
+
+    std::string host; // where the client's NetMessengerServer is listening
+    std::string port;
+};
+}
+
+#endif
\ No newline at end of file
@@ -10,12 +10,14 @@ using namespace Aftr;
 NetMsgMacroDefinition(NetMsgNewModel);
 
 NetMsgNewModel::NetMsgNewModel() {
+    id = 0;
     path = "";
     scale = Vector(1, 1, 1);
 }
 
 bool NetMsgNewModel::toStream(NetMessengerStreamBuffer& os) const
 {
+    os << id;
     os << path;
     os << scale.x << scale.y << scale.z;
     os << position.x << position.y << position.z;
@@ -25,6 +27,7 @@ bool NetMsgNewModel::toStream(NetMessengerStreamBuffer& os) const
 
 bool NetMsgNewModel::fromStream(NetMessengerStreamBuffer& is)
 {
+    is >> id;
     is >> path;
     is >> scale.x >> scale.y >> scale.z;
     is >> position.x >> position.y >> position.z;
@@ -34,13 +37,18 @@ bool NetMsgNewModel::fromStream(NetMessengerStreamBuffer& is)
 
 void NetMsgNewModel::onMessageArrived()
 {
-    // call spawnNewModel in GLView
-    ManagerGLView::getGLView<GLViewPhysicsModule>()->spawnNewModel(path, scale, position, false);
+    // the simulating instance spawns the requested model and replicates it to
+    // every client, clients just place it at the id they were given
+    GLViewPhysicsModule* glv = ManagerGLView::getGLView<GLViewPhysicsModule>();
+    if (glv->isAuthoritative())
+        glv->spawnNewModel(path, scale, position);
+    else
+        glv->queueModel(id, path, scale, position);
 }
 
 std::string NetMsgNewModel::toString() const
 {
     std::stringstream ss;
-    ss << "NewModel | " << path << " | " << scale;
+    ss << "NewModel | " << id << " | " << path << " | " << scale;
     return ss.str();
 }
\ No newline at end of file
@@ -19,6 +19,7 @@ public:
     virtual void onMessageArrived();
     virtual std::string toString() const;
 
+    unsigned int id; // assigned by the simulating instance, ignored in spawn requests
     std::string path;
     Vector scale;
     Vector position;
@@ -0,0 +1,48 @@
+#include "NetMsgSnapshotChunk.h"
+
+#include <sstream>
+
+#include "GLViewPhysicsModule.h"
+#include "ManagerGLView.h"
+
+using namespace Aftr;
+
+NetMsgMacroDefinition(NetMsgSnapshotChunk);
+
+NetMsgSnapshotChunk::NetMsgSnapshotChunk()
+{
+    snapshotID = 0;
+    index = 0;
+    numChunks = 0;
+    rawSize = 0;
+    data = "";
+}
+
+bool NetMsgSnapshotChunk::toStream(NetMessengerStreamBuffer& os) const
+{
+    os << snapshotID << index << numChunks << rawSize;
+    os << data;
+
+    return true;
+}
+
+bool NetMsgSnapshotChunk::fromStream(NetMessengerStreamBuffer& is)
+{
+    is >> snapshotID >> index >> numChunks >> rawSize;
+    is >> data;
+
+    return true;
+}
+
+void NetMsgSnapshotChunk::onMessageArrived()
+{
+    // call receiveSnapshotChunk in GLView
+    ManagerGLView::getGLView<GLViewPhysicsModule>()->receiveSnapshotChunk(*this);
+}
+
+std::string NetMsgSnapshotChunk::toString() const
+{
+    std::stringstream ss;
+    ss << "SnapshotChunk | " << snapshotID << " | " << index + 1 << "/" << numChunks << " | " << data.size() << " B";
+    return ss.str();
+}
\ No newline at end of file
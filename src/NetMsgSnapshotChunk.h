@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+#include "NetMsg.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+namespace Aftr {
+// one piece of a compressed full world snapshot streamed to a late joining client
+class NetMsgSnapshotChunk : public NetMsg {
+public:
+    NetMsgMacroDeclaration(NetMsgSnapshotChunk);
+
+    NetMsgSnapshotChunk();
+    virtual bool toStream(NetMessengerStreamBuffer& os) const;
+    virtual bool fromStream(NetMessengerStreamBuffer& is);
+    virtual void onMessageArrived();
+    virtual std::string toString() const;
+
+    unsigned int snapshotID;
+    unsigned int index;
+    unsigned int numChunks;
+    unsigned int rawSize; // size of the whole snapshot once decompressed
+    std::string data;
+};
+}
+
+#endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "GLViewPhysicsModule.h"
 #include "ManagerGLView.h"
+#include "ReplicationLatency.h"
 
 using namespace Aftr;
 
@@ -11,48 +12,73 @@ NetMsgMacroDefinition(NetMsgUpdateModel);
 
 NetMsgUpdateModel::NetMsgUpdateModel()
 {
-    id = 0;
-    displayMatrix = Mat4();
-    position = Vector(0, 0, 0);
+    count = 0;
+    encoding = ueRAW;
+    payload = nullptr;
+    tick = 0;
+    created = 0;
+    sent = 0;
+    received = 0;
 }
 
 bool NetMsgUpdateModel::toStream(NetMessengerStreamBuffer& os) const
 {
-    os << id;
-    for (size_t i = 0; i < 3; ++i) {
-        for (size_t j = 0; j < 3; ++j) {
-            os << displayMatrix[i * 4 + j];
-        }
-    }
-    os << position.x << position.y << position.z;
+    os << count;
+    os << encoding;
+    os << tick;
+    os << getTimestampHigh(created) << getTimestampLow(created);
+    os << getTimestampHigh(sent) << getTimestampLow(sent);
+    // by reference, a conditional expression here would copy the payload for every session
+    static const std::string empty;
+    os << (payload != nullptr ? *payload : empty);
 
     return true;
 }
 
 bool NetMsgUpdateModel::fromStream(NetMessengerStreamBuffer& is)
 {
-    is >> id;
-    for (size_t i = 0; i < 3; ++i) {
-        for (size_t j = 0; j < 3; ++j) {
-            is >> displayMatrix[i * 4 + j];
-        }
-    }
-    displayMatrix[15] = 1;
-    is >> position.x >> position.y >> position.z;
+    // stamped first thing, everything after this counts as waiting to be applied
+    received = getReplicationClock();
+
+    // the message outlives the messenger's receive buffer, so this one copy out of it is all
+    // the payload gets; it is handed to the message and decoded in place from there
+    std::string buf;
+    unsigned int high = 0, low = 0;
+    is >> count;
+    is >> encoding;
+    is >> tick;
+    is >> high >> low;
+    created = makeTimestamp(high, low);
+    is >> high >> low;
+    sent = makeTimestamp(high, low);
+    is >> buf;
+
+    if (encoding == ueRAW ? buf.size() != count * UPDATE_SIZE : encoding != uePOSE_STREAM)
+        return false;
+    payload = std::make_shared<const std::string>(std::move(buf));
 
     return true;
 }
 
 void NetMsgUpdateModel::onMessageArrived()
 {
-    // call spawnNewModel in GLView
-    ManagerGLView::getGLView<GLViewPhysicsModule>()->updateModel(id, displayMatrix, position);
+    if (payload == nullptr)
+        return;
+
+    GLViewPhysicsModule* glv = ManagerGLView::getGLView<GLViewPhysicsModule>();
+    if (encoding == uePOSE_STREAM) {
+        glv->applyCompressedPoses(payload->data(), payload->size(), count);
+    } else {
+        // decode straight from the received payload into the models
+        glv->applyPoses(payload->data(), count);
+    }
+    glv->recordUpdateLatency(*this);
 }
 
 std::string NetMsgUpdateModel::toString() const
 {
-    //std::stringstream ss;
-    //ss << "UpdateModel | " << id << " | " << displayMatrix << " | " << position;
-    //return ss.str();
-    return "";
+    std::stringstream ss;
+    ss << "UpdateModel | tick " << tick << " | " << count << " models | " << (payload != nullptr ? payload->size() : 0) << " B"
+       << (encoding == uePOSE_STREAM ? " compressed" : "");
+    return ss.str();
 }
\ No newline at end of file
@@ -1,28 +1,50 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #include "Mat4.h"
 #include "NetMsg.h"
+#include "PoseWire.h"
 #include "Vector.h"
 
 #ifdef AFTR_CONFIG_USE_BOOST
 
 namespace Aftr {
-// message for updating a model
+// message for updating a batch of models; the payload is encoded once per tick
+// and shared by every session the message is sent to
 class NetMsgUpdateModel : public NetMsg {
 public:
     NetMsgMacroDeclaration(NetMsgUpdateModel);
 
+    // size of one encoded update, see PoseWire
+    static const size_t UPDATE_SIZE = sizeof(PoseWire);
+
+    enum UPDATE_ENCODING : unsigned int {
+        ueRAW = 0, // count PoseWire records
+        uePOSE_STREAM = 1 // compressed by the connection's PoseStreamCompressor
+    };
+
     NetMsgUpdateModel();
     virtual bool toStream(NetMessengerStreamBuffer& os) const;
     virtual bool fromStream(NetMessengerStreamBuffer& is);
     virtual void onMessageArrived();
     virtual std::string toString() const;
 
-    unsigned int id;
-    Mat4 displayMatrix;
-    Vector position;
+    // encodes one model's pose into UPDATE_SIZE bytes at out
+    static void encodeUpdate(char* out, unsigned int id, const Mat4& displayMatrix, const Vector& position)
+    {
+        PoseWire::encode(out, id, displayMatrix, position);
+    }
+
+    unsigned int count;
+    unsigned int encoding;
+    std::shared_ptr<const std::string> payload;
+    unsigned int tick; // simulation tick the poses are from
+    uint64_t created; // server clock when the update was queued
+    uint64_t sent; // server clock, stamped by the session right before sending
+    uint64_t received; // local clock when this instance read the message, not streamed
 };
 }
 
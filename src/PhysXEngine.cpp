@@ -1,15 +1,58 @@
 #include "PhysXEngine.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
+#include "BinaryMesh.h"
 #include "Model.h"
+#include "PhysXRecorder.h"
+#include "PhysXTriggerListener.h"
 #include "WOPhysXActor.h"
 
 using namespace Aftr;
 using namespace physx;
 
-PhysXEngine::PhysXEngine()
+// true on the thread started by startThread, the only one allowed to touch the scene while threaded
+static thread_local bool onPhysicsThread = false;
+
+// scene checkpoint layout: SceneFileHeader, numEntries entries (u32 id, u8 isStatic,
+// u32 name length, name, 3 floats scale), padding up to binaryOffset, PhysX binary collection
+struct SceneFileHeader {
+    static const uint32_t MAGIC = 0x53585041; // "APXS"
+    static const uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t physxVersion; // binary collections only load into the PhysX version that wrote them
+    uint32_t numEntries;
+    uint64_t binaryOffset; // multiple of PX_SERIAL_FILE_ALIGN
+    uint64_t binarySize;
+};
+
+PhysXEngine::PhysXEngine(const PhysXEngineDesc& desc)
+    : eventQueue(4096)
+    , eventCallback(eventQueue)
 {
+    // by default dynamic bodies report hitting the terrain and each other
+    contactReportMasks[pcgDYNAMIC] = pcgSTATIC | pcgDYNAMIC;
+    sleepEventsEnabled = false;
+    stopping = false;
+    step = 0;
+    unseenThrough = 0;
+    shardWidth = desc.shardWidth;
+    shardMargin = desc.shardMargin;
+    numMigrations = 0;
+    nextID = 0;
+    proxyUserData = { PHYSX_USER_DATA_TYPE::pudPROXY, 0 };
+
     foundation = PxCreateFoundation(PX_PHYSICS_VERSION, allocator, errCallback);
 
     pvd = PxCreatePvd(*foundation);
@@ -21,20 +64,32 @@ PhysXEngine::PhysXEngine()
 
     PxSceneDesc s(physics->getTolerancesScale());
     s.gravity = PxVec3(0.0f, 0.0f, -9.81f);
-    dispatcher = PxDefaultCpuDispatcherCreate(4);
+    dispatcher = PxDefaultCpuDispatcherCreate(desc.numThreads);
     s.cpuDispatcher = dispatcher;
-    s.filterShader = PxDefaultSimulationFilterShader;
-    s.flags = PxSceneFlag::eENABLE_ACTIVE_ACTORS;
-    scene = physics->createScene(s);
+    s.filterShader = PhysXEventCallback::filterShader;
+    s.simulationEventCallback = &eventCallback;
+    // CCD is only done for bodies that enable it, see PhysXLODManager
+    s.flags = PxSceneFlag::eENABLE_ACTIVE_ACTORS | PxSceneFlag::eENABLE_CCD;
+    if (desc.enhancedDeterminism)
+        s.flags |= PxSceneFlag::eENABLE_ENHANCED_DETERMINISM;
+    // kinematic proxies (e.g. the camera) need to overlap static triggers
+    s.staticKineFilteringMode = PxPairFilteringMode::eKEEP;
 
-    PxPvdSceneClient* pvdClient = scene->getScenePvdClient();
-    if (pvdClient) {
-        pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
-        pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
-        pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
+    // every shard reports into the same event queue, fetchResults is only ever called
+    // by one thread at a time so the queue still has a single producer
+    for (unsigned int i = 0; i < std::max(1u, desc.numShards); ++i) {
+        PxScene* scene = physics->createScene(s);
+        PxPvdSceneClient* pvdClient = scene->getScenePvdClient();
+        if (pvdClient) {
+            pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
+            pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
+            pvdClient->setScenePvdFlag(PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
+        }
+        scenes.push_back(scene);
     }
 
     defaultMaterial = physics->createMaterial(0.5f, 0.5f, 0.6f);
+    serializationRegistry = PxSerialization::createSerializationRegistry(*physics);
 
     std::cout << "Successfully initialized PhysX engine" << std::endl;
 }
@@ -46,6 +101,19 @@ PhysXEngine::~PhysXEngine()
 
 void PhysXEngine::shutdown()
 {
+    stopThread();
+    if (recorder != nullptr) {
+        recorder->flush();
+        recorder = nullptr;
+    }
+    actorsByID.clear();
+    idsByActor.clear();
+    bodyOwners.clear();
+    triggerOwners.clear();
+    mirrors.clear();
+    activeActors.clear();
+    restoredActors.clear();
+
     // release shape maps
     for (auto const& x : triangleMeshShapes) {
         x.second->release();
@@ -60,14 +128,21 @@ void PhysXEngine::shutdown()
         defaultMaterial->release();
         defaultMaterial = nullptr;
     }
-    if (scene != nullptr) {
+    if (serializationRegistry != nullptr) {
+        serializationRegistry->release();
+        serializationRegistry = nullptr;
+    }
+    for (PxScene* scene : scenes) {
         scene->release();
-        scene = nullptr;
     }
+    scenes.clear();
     if (physics != nullptr) {
         physics->release();
         physics = nullptr;
     }
+    // only once nothing can refer to the objects deserialized into them
+    loadedScenes.clear();
+    userData.clear();
     if (cooking != nullptr) {
         cooking->release();
         cooking = nullptr;
@@ -86,110 +161,891 @@ void PhysXEngine::shutdown()
     }
 }
 
-PxRigidActor* PhysXEngine::createTriangleMesh(WOPhysXActor* wo)
+PxRigidActor* PhysXEngine::createTriangleMesh(const PhysXMeshData& mesh, unsigned int id, const PxTransform& pose)
 {
-    ModelDataShared* modelData = wo->getModel()->getModelDataShared();
-    ModelDataSharedID modelID(modelData->getFileName(), modelData->getInitialScaleFactor());
-    PxShape* shape;
+    Vector scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
+    ModelDataSharedID modelID(mesh.fileName, scale);
+
+    if (triangleMeshShapes.find(modelID) == triangleMeshShapes.end()) {
+        // a converted binary mesh skips rebuilding the composite lists, and usually cooking too
+        BinaryMesh binary;
+        bool useBinary = binary.open(BinaryMesh::getBinaryFileName(mesh.fileName)) && binary.isConversionOf(mesh.fileName, scale);
+        size_t cookedSize = 0;
+        const void* cooked = useBinary ? binary.getCookedTriangleMesh(cookedSize) : nullptr;
+
+        if (!useBinary && mesh.vertices.empty()) {
+            std::cout << "No geometry to cook a triangle mesh for " << mesh.fileName << std::endl;
+            return nullptr;
+        }
 
-    auto it = triangleMeshShapes.find(modelID);
-    if (it == triangleMeshShapes.end()) {
-        const std::vector<Vector>& verts = wo->getModel()->getCompositeVertexList();
-        const std::vector<unsigned int>& inds = wo->getModel()->getCompositeIndexList();
-
-        // describe triangle mesh geometry
-        PxTriangleMeshDesc desc;
-        desc.points.count = PxU32(verts.size());
-        desc.points.stride = sizeof(Vector);
-        desc.points.data = &verts.front();
-        desc.triangles.count = PxU32(inds.size() / 3);
-        desc.triangles.stride = sizeof(unsigned int) * 3;
-        desc.triangles.data = &inds.front();
-
-        // cook geometry into triangle mesh
         PxDefaultMemoryOutputStream buf;
-        if (!cooking->cookTriangleMesh(desc, buf))
-            exit(-1);
-        PxDefaultMemoryInputData stream(buf.getData(), buf.getSize());
-        PxTriangleMesh* triangleMesh = physics->createTriangleMesh(stream);
-        
-        // create shape and add it to map
-        shape = physics->createShape(PxTriangleMeshGeometry(triangleMesh), *defaultMaterial);
-        triangleMeshShapes.insert(std::make_pair(modelID, shape));
-    } else {
-        // reuse existing shape
-        shape = it->second;
+        if (cooked == nullptr) {
+            // describe triangle mesh geometry
+            PxTriangleMeshDesc desc;
+            if (useBinary) {
+                desc.points.count = PxU32(binary.getNumVertices());
+                desc.points.stride = 3 * sizeof(float);
+                desc.points.data = binary.getVertices();
+                desc.triangles.count = PxU32(binary.getNumIndices() / 3);
+                desc.triangles.data = binary.getIndices();
+            } else {
+                desc.points.count = PxU32(mesh.vertices.size());
+                desc.points.stride = sizeof(PxVec3);
+                desc.points.data = mesh.vertices.data();
+                desc.triangles.count = PxU32(mesh.indices.size() / 3);
+                desc.triangles.data = mesh.indices.data();
+            }
+            desc.triangles.stride = sizeof(unsigned int) * 3;
+
+            // cook geometry into triangle mesh
+            if (!cooking->cookTriangleMesh(desc, buf))
+                exit(-1);
+            cooked = buf.getData();
+            cookedSize = buf.getSize();
+        }
+        addCookedMesh(mesh.fileName, mesh.scale, true, cooked, cookedSize);
     }
+    auto it = triangleMeshShapes.find(modelID);
+    if (it == triangleMeshShapes.end())
+        return nullptr;
 
     // create actor and add it to scene
-    PxRigidStatic* actor = PxCreateStatic(*physics, PxTransform(PxVec3(0, 0, 0)), *shape);
-    scene->addActor(*actor);
-    actor->userData = wo;
+    PxRigidStatic* actor = PxCreateStatic(*physics, pose, *it->second);
+    scenes[0]->addActor(*actor);
+    registerActor(actor, id, PHYSX_USER_DATA_TYPE::pudBODY);
+    mirrorStatic(actor);
+    if (recorder != nullptr)
+        recorder->recordCreate(rmTRIANGLE_MESH, id, pose, mesh.fileName, mesh.scale);
 
     return actor;
 }
 
-PxRigidActor* PhysXEngine::createConvexMesh(WOPhysXActor* wo)
+PxRigidActor* PhysXEngine::createConvexMesh(const PhysXMeshData& mesh, unsigned int id, const PxTransform& pose)
 {
-    ModelDataShared* modelData = wo->getModel()->getModelDataShared();
-    ModelDataSharedID modelID(modelData->getFileName(), modelData->getInitialScaleFactor());
-    PxShape* shape;
+    Vector scale(mesh.scale.x, mesh.scale.y, mesh.scale.z);
+    ModelDataSharedID modelID(mesh.fileName, scale);
+
+    if (convexMeshShapes.find(modelID) == convexMeshShapes.end()) {
+        // a converted binary mesh skips rebuilding the composite lists, and usually cooking too
+        BinaryMesh binary;
+        bool useBinary = binary.open(BinaryMesh::getBinaryFileName(mesh.fileName)) && binary.isConversionOf(mesh.fileName, scale);
+        size_t cookedSize = 0;
+        const void* cooked = useBinary ? binary.getCookedConvexMesh(cookedSize) : nullptr;
+
+        if (!useBinary && mesh.vertices.empty()) {
+            std::cout << "No geometry to cook a convex mesh for " << mesh.fileName << std::endl;
+            return nullptr;
+        }
 
-    auto it = convexMeshShapes.find(modelID);
-    if (it == convexMeshShapes.end()) {
-        const std::vector<Vector>& verts = wo->getModel()->getCompositeVertexList();
-        const std::vector<unsigned int>& inds = wo->getModel()->getCompositeIndexList();
-
-        // describe convex mesh geometry
-        PxConvexMeshDesc desc;
-        desc.points.count = PxU32(verts.size());
-        desc.points.stride = sizeof(Vector);
-        desc.points.data = &verts.front();
-        desc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
-
-        // cook geometry into convex mesh
         PxDefaultMemoryOutputStream buf;
-        if (!cooking->cookConvexMesh(desc, buf))
-            exit(-1);
-        PxDefaultMemoryInputData stream(buf.getData(), buf.getSize());
-        PxConvexMesh* triangleMesh = physics->createConvexMesh(stream);
-
-        // create shape and add it to map
-        shape = physics->createShape(PxConvexMeshGeometry(triangleMesh), *defaultMaterial);
-        convexMeshShapes.insert(std::make_pair(modelID, shape));
-    } else {
-        // reuse existing shape
-        shape = it->second;
+        if (cooked == nullptr) {
+            // describe convex mesh geometry
+            PxConvexMeshDesc desc;
+            if (useBinary) {
+                desc.points.count = PxU32(binary.getNumVertices());
+                desc.points.stride = 3 * sizeof(float);
+                desc.points.data = binary.getVertices();
+            } else {
+                desc.points.count = PxU32(mesh.vertices.size());
+                desc.points.stride = sizeof(PxVec3);
+                desc.points.data = mesh.vertices.data();
+            }
+            desc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
+
+            // cook geometry into convex mesh
+            if (!cooking->cookConvexMesh(desc, buf))
+                exit(-1);
+            cooked = buf.getData();
+            cookedSize = buf.getSize();
+        }
+        addCookedMesh(mesh.fileName, mesh.scale, false, cooked, cookedSize);
     }
+    auto it = convexMeshShapes.find(modelID);
+    if (it == convexMeshShapes.end())
+        return nullptr;
 
     // create actor and add it to scene
-    PxRigidDynamic* actor = PxCreateDynamic(*physics, PxTransform(PxVec3(0, 0, 0)), *shape, PxReal(2.0f));
-    scene->addActor(*actor);
-    actor->userData = wo;
+    PxRigidDynamic* actor = PxCreateDynamic(*physics, pose, *it->second, PxReal(2.0f));
+    actor->setActorFlag(PxActorFlag::eSEND_SLEEP_NOTIFIES, sleepEventsEnabled);
+    getShardScene(pose.p)->addActor(*actor);
+    registerActor(actor, id, PHYSX_USER_DATA_TYPE::pudBODY);
+    if (recorder != nullptr)
+        recorder->recordCreate(rmCONVEX_MESH, id, pose, mesh.fileName, mesh.scale);
+
+    return actor;
+}
+
+void PhysXEngine::addCookedMesh(const std::string& fileName, const PxVec3& scale, bool triangleMesh, const void* cooked, size_t size)
+{
+    ModelDataSharedID modelID(fileName, Vector(scale.x, scale.y, scale.z));
+    std::map<ModelDataSharedID, PxShape*>& shapes = triangleMesh ? triangleMeshShapes : convexMeshShapes;
+    if (shapes.find(modelID) != shapes.end())
+        return;
+
+    PxDefaultMemoryInputData stream(static_cast<PxU8*>(const_cast<void*>(cooked)), PxU32(size));
+    PxGeometryHolder geometry;
+    if (triangleMesh) {
+        PxTriangleMesh* triangles = physics->createTriangleMesh(stream);
+        if (triangles != nullptr)
+            geometry = PxTriangleMeshGeometry(triangles);
+    } else {
+        PxConvexMesh* convex = physics->createConvexMesh(stream);
+        if (convex != nullptr)
+            geometry = PxConvexMeshGeometry(convex);
+    }
+    if (geometry.getType() == PxGeometryType::eINVALID) {
+        std::cout << "Invalid cooked mesh for " << fileName << std::endl;
+        return;
+    }
+    if (recorder != nullptr)
+        recorder->recordMesh(triangleMesh ? rmTRIANGLE_MESH : rmCONVEX_MESH, fileName, scale, cooked, size);
+
+    // create shape and add it to map
+    PxU32 group = triangleMesh ? pcgSTATIC : pcgDYNAMIC;
+    PxShape* shape = physics->createShape(geometry.any(), *defaultMaterial);
+    shape->setSimulationFilterData(getFilterData(group));
+    shape->setQueryFilterData(PxFilterData(group, 0, 0, 0));
+    shapes.insert(std::make_pair(modelID, shape));
+}
+
+bool PhysXEngine::needsMeshData(const std::string& fileName, const PxVec3& scale, bool triangleMesh)
+{
+    ModelDataSharedID modelID(fileName, Vector(scale.x, scale.y, scale.z));
+    std::set<ModelDataSharedID>& requested = triangleMesh ? requestedTriangleMeshes : requestedConvexMeshes;
+    if (!requested.insert(modelID).second)
+        return false;
+
+    BinaryMesh binary;
+    return !(binary.open(BinaryMesh::getBinaryFileName(fileName)) && binary.isConversionOf(fileName, Vector(scale.x, scale.y, scale.z)));
+}
+
+PxRigidActor* PhysXEngine::createTriggerSphere(unsigned int id, const PxVec3& position, float radius)
+{
+    // shared, so the mirrors in the other shards can attach it too
+    PxShape* shape = physics->createShape(PxSphereGeometry(radius), *defaultMaterial, false);
+    shape->setFlag(PxShapeFlag::eSIMULATION_SHAPE, false);
+    shape->setFlag(PxShapeFlag::eSCENE_QUERY_SHAPE, false);
+    shape->setFlag(PxShapeFlag::eTRIGGER_SHAPE, true);
+    shape->setSimulationFilterData(getFilterData(pcgTRIGGER));
+
+    PxRigidStatic* actor = PxCreateStatic(*physics, PxTransform(position), *shape);
+    shape->release(); // actor holds the only reference now
+    scenes[0]->addActor(*actor);
+    registerActor(actor, id, PHYSX_USER_DATA_TYPE::pudTRIGGER);
+    mirrorStatic(actor);
 
     return actor;
 }
 
-void PhysXEngine::destroyActor(PxActor* actor)
+PxRigidDynamic* PhysXEngine::createKinematicSphere(const PxVec3& position, float radius)
 {
-    if (scene != nullptr) {
+    PxShape* shape = physics->createShape(PxSphereGeometry(radius), *defaultMaterial, true);
+    shape->setSimulationFilterData(getFilterData(pcgPROXY));
+    shape->setFlag(PxShapeFlag::eSCENE_QUERY_SHAPE, false);
+
+    PxRigidDynamic* actor = PxCreateKinematic(*physics, PxTransform(position), *shape, PxReal(1.0f));
+    shape->release();
+    getShardScene(position)->addActor(*actor);
+    actor->userData = &proxyUserData;
+
+    return actor;
+}
+
+void PhysXEngine::moveTrigger(unsigned int id, const PxVec3& position)
+{
+    // not recorded, triggers have no say in how bodies move
+    PxRigidActor* trigger = getActor(id);
+    if (trigger == nullptr)
+        return;
+
+    PxTransform pose(position);
+    trigger->setGlobalPose(pose);
+
+    auto it = mirrors.find(trigger);
+    if (it != mirrors.end()) {
+        for (PxRigidStatic* mirror : it->second) {
+            mirror->setGlobalPose(pose);
+        }
+    }
+}
+
+void PhysXEngine::destroyActor(unsigned int id)
+{
+    PxRigidActor* actor = getActor(id);
+    if (actor == nullptr)
+        return;
+
+    // ids are never reused, just forget the actor
+    actorsByID[id] = nullptr;
+    idsByActor.erase(actor);
+    restoredActors.erase(std::remove(restoredActors.begin(), restoredActors.end(), actor), restoredActors.end());
+
+    auto it = mirrors.find(actor);
+    if (it != mirrors.end()) {
+        for (PxRigidStatic* mirror : it->second) {
+            mirror->getScene()->removeActor(*mirror);
+            mirror->release();
+        }
+        mirrors.erase(it);
+    }
+
+    std::shared_ptr<LoadedScene> loaded;
+    auto load = loadedScenes.find(actor);
+    if (load != loadedScenes.end()) {
+        loaded = load->second;
+        loadedScenes.erase(load);
+    }
+
+    if (PxScene* scene = actor->getScene()) {
         scene->removeActor(*actor);
         actor->release();
     }
+
+    // the last actor of a loaded scene takes what's left of it along, its memory goes with loaded
+    if (loaded != nullptr && loaded.use_count() == 1) {
+        for (PxBase* object : loaded->objects) {
+            object->release();
+        }
+    }
+}
+
+void PhysXEngine::registerActor(PxRigidActor* actor, unsigned int id, PHYSX_USER_DATA_TYPE type)
+{
+    if (id >= actorsByID.size())
+        actorsByID.resize(id + 1, nullptr);
+    actorsByID[id] = actor;
+    idsByActor[actor] = id;
+
+    // ids reserved but not created yet get their tag filled in once they are
+    while (userData.size() <= id) {
+        userData.push_back({ PHYSX_USER_DATA_TYPE::pudBODY, static_cast<unsigned int>(userData.size()) });
+    }
+    userData[id].type = type;
+    actor->userData = &userData[id];
+}
+
+void PhysXEngine::setBodyOwner(unsigned int id, WOPhysXActor* owner)
+{
+    if (id >= bodyOwners.size()) {
+        if (owner == nullptr)
+            return;
+        bodyOwners.resize(id + 1, nullptr);
+    }
+    bodyOwners[id] = owner;
+}
+
+void PhysXEngine::setTriggerOwner(unsigned int id, PhysXTriggerListener* owner)
+{
+    if (id >= triggerOwners.size()) {
+        if (owner == nullptr)
+            return;
+        triggerOwners.resize(id + 1, nullptr);
+    }
+    triggerOwners[id] = owner;
+}
+
+WOPhysXActor* PhysXEngine::getBodyOwner(const void* userData) const
+{
+    const PhysXUserData* data = static_cast<const PhysXUserData*>(userData);
+    return data != nullptr && data->type == PHYSX_USER_DATA_TYPE::pudBODY ? getBodyOwner(data->id) : nullptr;
+}
+
+PhysXTriggerListener* PhysXEngine::getTriggerOwner(const void* userData) const
+{
+    const PhysXUserData* data = static_cast<const PhysXUserData*>(userData);
+    if (data == nullptr || data->type != PHYSX_USER_DATA_TYPE::pudTRIGGER || data->id >= triggerOwners.size())
+        return nullptr;
+    return triggerOwners[data->id];
+}
+
+void PhysXEngine::setActorPose(unsigned int id, const PxTransform& pose)
+{
+    PxRigidActor* actor = getActor(id);
+    if (actor == nullptr)
+        return;
+
+    if (recorder != nullptr)
+        recorder->recordPush(id, pose);
+    actor->setGlobalPose(pose);
+
+    auto it = mirrors.find(actor);
+    if (it != mirrors.end()) {
+        for (PxRigidStatic* mirror : it->second) {
+            mirror->setGlobalPose(pose);
+        }
+    }
+    // a teleport shouldn't wait for the next step to land in the right shard
+    migrate(actor);
+}
+
+unsigned int PhysXEngine::getShard(const PxVec3& position) const
+{
+    if (scenes.size() <= 1)
+        return 0;
+
+    // slabs along x, centered on the origin
+    float slab = std::floor(position.x / shardWidth + 0.5f * float(scenes.size()));
+    return static_cast<unsigned int>(std::min(std::max(slab, 0.0f), float(scenes.size() - 1)));
+}
+
+void PhysXEngine::mirrorStatic(PxRigidStatic* actor)
+{
+    if (scenes.size() <= 1)
+        return;
+
+    // the copies share the shapes, so only the actors themselves are duplicated. Exclusive
+    // shapes (e.g. out of a loaded collection) can't be shared and get a copy per mirror.
+    PxShape* shapes[8];
+    PxU32 numShapes = actor->getShapes(shapes, 8);
+    std::vector<PxRigidStatic*>& copies = mirrors[actor];
+    for (size_t i = 1; i < scenes.size(); ++i) {
+        PxRigidStatic* mirror = physics->createRigidStatic(actor->getGlobalPose());
+        for (PxU32 j = 0; j < numShapes; ++j) {
+            PxShape* shape = shapes[j];
+            bool copied = shape->isExclusive();
+            if (copied) {
+                PxMaterial* materials[8];
+                PxU16 numMaterials = static_cast<PxU16>(shape->getMaterials(materials, 8));
+                shape = physics->createShape(shape->getGeometry().any(), materials, numMaterials, true, shape->getFlags());
+                shape->setLocalPose(shapes[j]->getLocalPose());
+                shape->setSimulationFilterData(shapes[j]->getSimulationFilterData());
+                shape->setQueryFilterData(shapes[j]->getQueryFilterData());
+            }
+            if (!mirror->attachShape(*shape))
+                std::cout << "Failed to attach a shape to the static mirror in shard " << i << std::endl;
+            if (copied)
+                shape->release(); // mirror holds the only reference now
+        }
+        mirror->userData = actor->userData;
+        scenes[i]->addActor(*mirror);
+        copies.push_back(mirror);
+    }
+}
+
+void PhysXEngine::migrate(PxRigidActor* actor)
+{
+    PxRigidDynamic* body = actor->is<PxRigidDynamic>();
+    PxScene* from = actor->getScene();
+    if (body == nullptr || from == nullptr || scenes.size() <= 1)
+        return;
+
+    PxVec3 position = body->getGlobalPose().p;
+    unsigned int shard = getShard(position);
+    if (scenes[shard] == from)
+        return;
+    // hysteresis, a body resting on a border mustn't bounce between scenes every step
+    PxVec3 margin(shardMargin, 0.0f, 0.0f);
+    if (getShard(position - margin) != shard || getShard(position + margin) != shard)
+        return;
+
+    bool kinematic = body->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC;
+    bool sleeping = body->isSleeping();
+    PxVec3 linear = body->getLinearVelocity();
+    PxVec3 angular = body->getAngularVelocity();
+
+    from->removeActor(*body);
+    scenes[shard]->addActor(*body);
+    if (!kinematic) {
+        if (sleeping) {
+            body->putToSleep();
+        } else {
+            body->setLinearVelocity(linear);
+            body->setAngularVelocity(angular);
+        }
+    }
+    ++numMigrations;
+}
+
+bool PhysXEngine::saveScene(const std::string& fileName, const std::vector<PhysXSceneEntry>& models)
+{
+    PxCollection* collection = PxCreateCollection();
+    std::vector<PhysXSceneEntry> entries;
+    for (unsigned int id = 0; id < actorsByID.size(); ++id) {
+        PxRigidActor* actor = actorsByID[id];
+        // triggers are recreated by their listeners, like the proxies
+        if (actor == nullptr || static_cast<const PhysXUserData*>(actor->userData)->type != PHYSX_USER_DATA_TYPE::pudBODY)
+            continue;
+
+        // serial ids start at 1, 0 means none
+        collection->add(*actor, PxSerialObjectId(id) + 1);
+        PhysXSceneEntry entry = { id, actor->is<PxRigidStatic>() != nullptr, "", PxVec3(1.0f), actor->getGlobalPose() };
+        if (id < models.size() && !models[id].fileName.empty()) {
+            entry.fileName = models[id].fileName;
+            entry.scale = models[id].scale;
+        }
+        entries.push_back(entry);
+    }
+
+    // pulls in the shapes, meshes and materials, each shared one only once
+    PxSerialization::complete(*collection, *serializationRegistry);
+    PxDefaultMemoryOutputStream binary;
+    bool serialized = PxSerialization::serializeCollectionToBinary(binary, *collection, *serializationRegistry);
+    collection->release();
+    if (!serialized)
+        return false;
+
+    std::string table;
+    for (const PhysXSceneEntry& entry : entries) {
+        uint32_t id = entry.id;
+        uint8_t isStatic = entry.isStatic ? 1 : 0;
+        uint32_t length = static_cast<uint32_t>(entry.fileName.size());
+        table.append(reinterpret_cast<const char*>(&id), sizeof(id));
+        table.append(reinterpret_cast<const char*>(&isStatic), sizeof(isStatic));
+        table.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        table.append(entry.fileName);
+        table.append(reinterpret_cast<const char*>(&entry.scale), 3 * sizeof(float));
+    }
+
+    SceneFileHeader header;
+    header.magic = SceneFileHeader::MAGIC;
+    header.version = SceneFileHeader::VERSION;
+    header.physxVersion = PX_PHYSICS_VERSION;
+    header.numEntries = static_cast<uint32_t>(entries.size());
+    header.binaryOffset = (sizeof(header) + table.size() + PX_SERIAL_FILE_ALIGN - 1) / PX_SERIAL_FILE_ALIGN * PX_SERIAL_FILE_ALIGN;
+    header.binarySize = binary.getSize();
+
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    std::string padding(size_t(header.binaryOffset) - sizeof(header) - table.size(), '\0');
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(table.data(), table.size());
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<const char*>(binary.getData()), binary.getSize());
+    return bool(out);
+}
+
+bool PhysXEngine::loadScene(const std::string& fileName, std::vector<PhysXSceneEntry>& restored)
+{
+    std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+    uint64_t fileSize = in.is_open() ? uint64_t(in.tellg()) : 0;
+    in.seekg(0);
+    SceneFileHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SceneFileHeader::MAGIC
+        || header.version != SceneFileHeader::VERSION || header.physxVersion != PX_PHYSICS_VERSION) {
+        std::cout << "Not a scene checkpoint of this PhysX version: " << fileName << std::endl;
+        return false;
+    }
+    // every entry takes at least its fixed size fields, so a corrupt count can't make us allocate the table
+    const uint64_t minEntrySize = 2 * sizeof(uint32_t) + sizeof(uint8_t) + 3 * sizeof(float);
+    if (header.numEntries > (fileSize - sizeof(header)) / minEntrySize || header.binaryOffset < sizeof(header)
+        || header.binaryOffset > fileSize || header.binarySize > fileSize - header.binaryOffset) {
+        std::cout << "Truncated or corrupt scene checkpoint: " << fileName << std::endl;
+        return false;
+    }
+
+    std::vector<PhysXSceneEntry> entries(header.numEntries);
+    for (PhysXSceneEntry& entry : entries) {
+        uint32_t id = 0, length = 0;
+        uint8_t isStatic = 0;
+        if (!(in.read(reinterpret_cast<char*>(&id), sizeof(id)) && in.read(reinterpret_cast<char*>(&isStatic), sizeof(isStatic))
+                && in.read(reinterpret_cast<char*>(&length), sizeof(length)) && length < (1u << 16)))
+            return false;
+        entry.id = id;
+        entry.isStatic = isStatic != 0;
+        entry.fileName.resize(length);
+        if (!(in.read(&entry.fileName[0], length) && in.read(reinterpret_cast<char*>(&entry.scale), 3 * sizeof(float))))
+            return false;
+    }
+
+    // objects are deserialized in place, so the block has to be aligned and outlive them
+    std::shared_ptr<LoadedScene> loaded = std::make_shared<LoadedScene>();
+    loaded->memory.reset(new char[size_t(header.binarySize) + PX_SERIAL_FILE_ALIGN]);
+    void* block = reinterpret_cast<void*>((reinterpret_cast<size_t>(loaded->memory.get()) + PX_SERIAL_FILE_ALIGN - 1) & ~size_t(PX_SERIAL_FILE_ALIGN - 1));
+    if (!in.seekg(std::streamoff(header.binaryOffset)) || !in.read(static_cast<char*>(block), std::streamsize(header.binarySize)))
+        return false;
+    PxCollection* collection = PxSerialization::createCollectionFromBinary(block, *serializationRegistry);
+    if (collection == nullptr)
+        return false;
+
+    for (PhysXSceneEntry& entry : entries) {
+        PxBase* object = collection->find(PxSerialObjectId(entry.id) + 1);
+        PxRigidActor* actor = object != nullptr ? object->is<PxRigidActor>() : nullptr;
+        if (actor == nullptr || getActor(entry.id) == actor)
+            continue;
+
+        destroyActor(entry.id);
+        // a model that is cooked already shares its shape instead of a second copy of the mesh
+        std::map<ModelDataSharedID, PxShape*>& shapes = actor->is<PxRigidStatic>() != nullptr ? triangleMeshShapes : convexMeshShapes;
+        auto cached = shapes.find(ModelDataSharedID(entry.fileName, Vector(entry.scale.x, entry.scale.y, entry.scale.z)));
+        PxShape* shape = nullptr;
+        if (!entry.fileName.empty() && cached != shapes.end() && actor->getShapes(&shape, 1) == 1 && actor->getNbShapes() == 1) {
+            actor->detachShape(*shape);
+            actor->attachShape(*cached->second);
+        }
+        registerActor(actor, entry.id, PHYSX_USER_DATA_TYPE::pudBODY);
+        loadedScenes[actor] = loaded;
+        // a checkpoint from an earlier run can hold ids this one hasn't handed out yet
+        unsigned int next = nextID.load();
+        while (next <= entry.id && !nextID.compare_exchange_weak(next, entry.id + 1)) {
+        }
+
+        if (PxRigidStatic* body = actor->is<PxRigidStatic>()) {
+            scenes[0]->addActor(*body);
+            mirrorStatic(body);
+        } else {
+            getShardScene(actor->getGlobalPose().p)->addActor(*actor);
+        }
+        restoredActors.push_back(actor);
+
+        entry.pose = actor->getGlobalPose();
+        restored.push_back(entry);
+    }
+
+    // the collection only groups the objects, the rest of them stay alive until the last
+    // restored actor is destroyed; actors no entry restored aren't needed at all
+    for (PxU32 i = 0; i < collection->getNbObjects(); ++i) {
+        PxBase& object = collection->getObject(i);
+        if (object.is<PxRigidActor>() == nullptr)
+            loaded->objects.push_back(&object);
+        else if (loadedScenes.find(object.is<PxRigidActor>()) == loadedScenes.end())
+            object.release();
+    }
+    collection->release();
+    if (loaded.use_count() == 1) {
+        for (PxBase* object : loaded->objects) {
+            object->release();
+        }
+    }
+    return true;
+}
+
+void PhysXEngine::printShardStats() const
+{
+    std::cout << "PhysX shards |";
+    for (PxScene* scene : scenes) {
+        std::cout << " " << scene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+    }
+    std::cout << " | migrations " << numMigrations << std::endl;
+}
+
+bool PhysXEngine::raycast(const PxVec3& origin, const PxVec3& unitDir, float maxDist, PhysXQueryHit& hit, PxU32 groups) const
+{
+    PxQueryFilterData filter(PxFilterData(groups, 0, 0, 0), PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC);
+
+    // closest hit over all shards, each later shard only has to beat the best one so far
+    hit.hit = false;
+    for (PxScene* scene : scenes) {
+        PxRaycastBuffer buf;
+        if (scene->raycast(origin, unitDir, maxDist, buf, PxHitFlag::eDEFAULT, filter) && buf.hasBlock) {
+            hit.hit = true;
+            hit.position = buf.block.position;
+            hit.normal = buf.block.normal;
+            hit.distance = buf.block.distance;
+            hit.userData = buf.block.actor->userData;
+            maxDist = buf.block.distance;
+        }
+    }
+    return hit.hit;
+}
+
+bool PhysXEngine::sweep(const PxGeometry& geometry, const PxTransform& pose, const PxVec3& unitDir, float maxDist,
+    PhysXQueryHit& hit, PxU32 groups) const
+{
+    PxQueryFilterData filter(PxFilterData(groups, 0, 0, 0), PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC);
+
+    hit.hit = false;
+    for (PxScene* scene : scenes) {
+        PxSweepBuffer buf;
+        if (scene->sweep(geometry, pose, unitDir, maxDist, buf, PxHitFlag::eDEFAULT, filter) && buf.hasBlock) {
+            hit.hit = true;
+            hit.position = buf.block.position;
+            hit.normal = buf.block.normal;
+            hit.distance = buf.block.distance;
+            hit.userData = buf.block.actor->userData;
+            maxDist = buf.block.distance;
+        }
+    }
+    return hit.hit;
+}
+
+size_t PhysXEngine::overlap(const PxGeometry& geometry, const PxTransform& pose, void** out, size_t maxHits, PxU32 groups) const
+{
+    const PxU32 bufferSize = 256;
+    PxOverlapHit touches[bufferSize];
+    PxOverlapBuffer buf(touches, bufferSize);
+    // no blocking hits, every overlap is reported as a touch
+    PxQueryFilterData filter(PxFilterData(groups, 0, 0, 0), PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC | PxQueryFlag::eNO_BLOCK);
+
+    size_t count = 0;
+    for (size_t s = 0; s < scenes.size() && count < maxHits; ++s) {
+        scenes[s]->overlap(geometry, pose, buf, filter);
+        for (PxU32 i = 0; i < buf.getNbTouches() && count < maxHits; ++i) {
+            const PxRigidActor* actor = buf.getTouch(i).actor;
+            // mirrored statics overlap in every shard but are only reported once
+            if (s > 0 && actor->is<PxRigidStatic>() != nullptr && actor->userData != nullptr
+                && std::find(out, out + count, actor->userData) != out + count)
+                continue;
+            out[count++] = actor->userData;
+        }
+    }
+    return count;
+}
+
+namespace {
+// a chunk of a raycast batch, run by a worker of the CPU dispatcher
+class PhysXRaycastTask : public PxLightCpuTask {
+public:
+    std::function<void()> work;
+    std::mutex* mutex;
+    std::condition_variable* done;
+    size_t* remaining;
+
+    void run() override { work(); }
+    const char* getName() const override { return "PhysXRaycastTask"; }
+    // the dispatcher calls this once run returns
+    void release() override
+    {
+        std::lock_guard<std::mutex> lock(*mutex);
+        if (--*remaining == 0)
+            done->notify_one();
+    }
+};
+}
+
+void PhysXEngine::raycastBatch(const PhysXRaycastQuery* queries, PhysXQueryHit* hits, size_t count, PxU32 groups) const
+{
+    // below this many rays per task the hand off costs more than it saves
+    const size_t minPerTask = 256;
+
+    auto runRange = [this, queries, hits, groups](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            raycast(queries[i].origin, queries[i].unitDir, queries[i].maxDist, hits[i], groups);
+        }
+    };
+
+    size_t chunks = std::min(size_t(dispatcher->getWorkerCount()) + 1, std::max(size_t(1), count / minPerTask));
+    if (chunks <= 1) {
+        runRange(0, count);
+        return;
+    }
+
+    // scene reads are safe from several threads while nothing is writing to the scene, and
+    // the dispatcher's workers are idle between steps; the calling thread takes the last chunk
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t remaining = chunks - 1;
+    std::vector<PhysXRaycastTask> tasks(chunks - 1);
+    size_t chunk = (count + chunks - 1) / chunks;
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        size_t begin = t * chunk, end = std::min(count, (t + 1) * chunk);
+        tasks[t].work = [&runRange, begin, end]() { runRange(begin, end); };
+        tasks[t].mutex = &mutex;
+        tasks[t].done = &done;
+        tasks[t].remaining = &remaining;
+        dispatcher->submitTask(tasks[t]);
+    }
+    runRange((chunks - 1) * chunk, count);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&remaining]() { return remaining == 0; });
+}
+
+void PhysXEngine::setContactReportMask(PxU32 group, PxU32 mask)
+{
+    contactReportMasks[group] = mask;
+
+    // refresh shapes that already exist, PhysX refilters their pairs on the next step
+    for (auto const& x : triangleMeshShapes) {
+        if (x.second->getSimulationFilterData().word0 == group)
+            x.second->setSimulationFilterData(getFilterData(group));
+    }
+    for (auto const& x : convexMeshShapes) {
+        if (x.second->getSimulationFilterData().word0 == group)
+            x.second->setSimulationFilterData(getFilterData(group));
+    }
+}
+
+PxFilterData PhysXEngine::getFilterData(PxU32 group) const
+{
+    auto it = contactReportMasks.find(group);
+    return PxFilterData(group, it != contactReportMasks.end() ? it->second : 0, 0, 0);
 }
 
 void PhysXEngine::updateSimulation(float dt)
 {
-    scene->simulate(dt);
-    scene->fetchResults(true);
+    if (isThreaded()) {
+        // command results first, so e.g. a spawn's callback runs before its first pose arrives
+        {
+            std::lock_guard<std::mutex> lock(callbackMutex);
+            runningCallbacks.swap(callbacks);
+        }
+        for (auto& callback : runningCallbacks) {
+            callback();
+        }
+        runningCallbacks.clear();
 
-    PxU32 numActors = 0;
-    PxActor** actors = scene->getActiveActors(numActors);
-    if (numActors > 0 && actors != nullptr) {
-        for (size_t i = 0; i < numActors; ++i) {
-            if (actors[i]->userData != nullptr) {
-                static_cast<WOPhysXActor*>(actors[i]->userData)->pullFromPhysX();
+        poseStore.clearDirty();
+        if (const PhysXPoseFrame* frame = poseBuffer.acquire()) {
+            for (size_t i = 0; i < frame->ids.size(); ++i) {
+                poseStore.set(frame->ids[i], frame->poses[i], frame->linearVelocities[i]);
             }
         }
+    } else {
+        stepSimulation(dt);
+
+        poseStore.clearDirty();
+        for (PxActor* active : activeActors) {
+            auto it = idsByActor.find(active);
+            if (it == idsByActor.end())
+                continue;
+            PxRigidActor* actor = active->is<PxRigidActor>();
+            PxRigidDynamic* body = active->is<PxRigidDynamic>();
+            poseStore.set(it->second, actor->getGlobalPose(), body != nullptr ? body->getLinearVelocity() : PxVec3(0.0f));
+        }
+    }
+
+    // the scene graph still needs every moved WO placed for rendering
+    for (unsigned int id : poseStore.getDirtyIDs()) {
+        if (WOPhysXActor* owner = getBodyOwner(id))
+            owner->applyPhysXPose(poseStore.getPosition(id), poseStore.getRotation(id));
+    }
+}
+
+void PhysXEngine::stepSimulation(float dt)
+{
+    if (recorder != nullptr)
+        recorder->recordStep(dt);
+
+    // the shards' tasks all go to the shared dispatcher, so they run in parallel
+    // until the first fetchResults has to wait
+    for (PxScene* scene : scenes) {
+        scene->simulate(dt);
+    }
+    for (PxScene* scene : scenes) {
+        scene->fetchResults(true);
+    }
+    ++step;
+
+    if (recorder != nullptr)
+        recorder->recordCheckpoint(actorsByID);
+
+    // copied out before migrating, moving actors between scenes invalidates the scenes' own lists
+    activeActors.clear();
+    for (PxScene* scene : scenes) {
+        PxU32 numActors = 0;
+        PxActor** actors = scene->getActiveActors(numActors);
+        if (actors != nullptr)
+            activeActors.insert(activeActors.end(), actors, actors + numActors);
+    }
+    // loaded actors that are asleep wouldn't show up, but their WOs still need the restored pose
+    activeActors.insert(activeActors.end(), restoredActors.begin(), restoredActors.end());
+    restoredActors.clear();
+    if (scenes.size() > 1) {
+        for (PxActor* actor : activeActors) {
+            migrate(actor->is<PxRigidActor>());
+        }
+    }
+}
+
+void PhysXEngine::startThread(float hz)
+{
+    if (isThreaded() || hz <= 0.0f)
+        return;
+
+    stopping = false;
+    physicsThread = std::thread([this, hz]() { runPhysicsThread(hz); });
+}
+
+void PhysXEngine::stopThread()
+{
+    if (!isThreaded())
+        return;
+
+    stopping = true;
+    physicsThread.join();
+
+    // whatever was queued after the last step still happens, now on this thread
+    std::vector<std::function<void(PhysXEngine&)>> remaining;
+    remaining.swap(commands);
+    for (auto& command : remaining) {
+        command(*this);
+    }
+    callbacks.clear();
+}
+
+void PhysXEngine::execute(const std::function<void(PhysXEngine&)>& command)
+{
+    if (onPhysicsThread || !isThreaded()) {
+        command(*this);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(commandMutex);
+    commands.push_back(command);
+}
+
+void PhysXEngine::runOnGameThread(const std::function<void()>& callback)
+{
+    if (!onPhysicsThread) {
+        callback();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    callbacks.push_back(callback);
+}
+
+void PhysXEngine::runPhysicsThread(float hz)
+{
+    using namespace std::chrono;
+
+    onPhysicsThread = true;
+    float dt = 1.0f / hz;
+    steady_clock::duration period = duration_cast<steady_clock::duration>(duration<float>(dt));
+    steady_clock::time_point next = steady_clock::now();
+
+    while (!stopping) {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            runningCommands.swap(commands);
+        }
+        for (auto& command : runningCommands) {
+            command(*this);
+        }
+        runningCommands.clear();
+
+        stepSimulation(dt);
+        publishPoses();
+
+        // after a long stall (e.g. a big spawn) start over instead of stepping in a burst to catch up
+        next += period;
+        steady_clock::time_point now = steady_clock::now();
+        if (now > next + 4 * period)
+            next = now;
+        else
+            std::this_thread::sleep_until(next);
+    }
+}
+
+void PhysXEngine::publishPoses()
+{
+    // an actor stays in the frames until the game thread has read one that holds its newest pose,
+    // so nothing is lost when the game thread skips frames
+    unsigned int consumed = poseBuffer.getConsumedStep();
+    changedStep.resize(actorsByID.size(), 0);
+
+    for (PxActor* actor : activeActors) {
+        auto it = idsByActor.find(actor);
+        if (it == idsByActor.end())
+            continue;
+        if (changedStep[it->second] <= unseenThrough)
+            unseenIDs.push_back(it->second);
+        changedStep[it->second] = step;
+    }
+    unseenIDs.erase(std::remove_if(unseenIDs.begin(), unseenIDs.end(), [this, consumed](unsigned int id) { return changedStep[id] <= consumed; }),
+        unseenIDs.end());
+    unseenThrough = consumed;
+
+    PhysXPoseFrame& frame = poseBuffer.getWriteFrame();
+    frame.clear();
+    frame.step = step;
+    for (unsigned int id : unseenIDs) {
+        PxRigidActor* actor = actorsByID[id];
+        if (actor == nullptr)
+            continue;
+        PxRigidDynamic* body = actor->is<PxRigidDynamic>();
+        frame.ids.push_back(id);
+        frame.poses.push_back(actor->getGlobalPose());
+        frame.linearVelocities.push_back(body != nullptr ? body->getLinearVelocity() : PxVec3(0.0f));
     }
+    poseBuffer.publish();
 }
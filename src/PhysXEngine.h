@@ -1,16 +1,88 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "PxPhysicsAPI.h"
 
+#include "PhysXEventCallback.h"
+#include "PhysXEventQueue.h"
+#include "PhysXPoseBuffer.h"
+#include "PhysXPoseStore.h"
+#include "PhysXUserData.h"
+
 namespace Aftr {
 class ModelDataSharedID;
+class PhysXRecorder;
+class PhysXTriggerListener;
 class WOPhysXActor;
 
+// construction options for PhysXEngine
+struct PhysXEngineDesc {
+    unsigned int numThreads = 4; // worker threads of the CPU dispatcher
+    bool enhancedDeterminism = false; // results don't depend on unrelated actors (needed for replays)
+    unsigned int numShards = 1; // scenes the world is split into along x, see PhysXEngine
+    float shardWidth = 100.0f; // x extent of each shard, the outermost ones are unbounded
+    float shardMargin = 2.0f; // how far past a border a body has to be before it migrates
+};
+
+// geometry of a WO's model for PhysXEngine::createTriangleMesh/createConvexMesh, gathered on
+// the game thread so the creation command never reads the model
+struct PhysXMeshData {
+    std::string fileName; // with scale, identifies models that can share a cooked shape
+    physx::PxVec3 scale;
+    std::vector<physx::PxVec3> vertices; // empty unless PhysXEngine::needsMeshData asked for them
+    std::vector<unsigned int> indices; // triangle meshes only
+};
+
+// one registered actor of a scene checkpoint, see PhysXEngine::saveScene
+struct PhysXSceneEntry {
+    unsigned int id;
+    bool isStatic;
+    std::string fileName; // model of the WOPhysXActor that owned it, empty if none
+    physx::PxVec3 scale;
+    physx::PxTransform pose; // as restored by loadScene, not part of the table
+};
+
+// single ray for PhysXEngine::raycastBatch
+struct PhysXRaycastQuery {
+    physx::PxVec3 origin;
+    physx::PxVec3 unitDir;
+    float maxDist;
+};
+
+// closest hit returned by the scene query methods
+struct PhysXQueryHit {
+    bool hit;
+    physx::PxVec3 position;
+    physx::PxVec3 normal;
+    float distance;
+    void* userData; // userData of the actor that was hit, a PhysXUserData
+};
+
+// Owns the PhysX scene. By default everything runs on the game thread and
+// updateSimulation steps the scene. After startThread the scene is stepped at a
+// fixed rate on its own thread instead: anything that touches the scene must then
+// go through execute, and updateSimulation only applies the newest published poses.
+//
+// With more than one shard the world is split into slabs along x, each with its own
+// PxScene. All scenes share the dispatcher and are simulated at the same time, dynamic
+// bodies migrate to the scene of the slab they moved into, and static actors and
+// triggers are mirrored into every scene. Bodies in different shards don't collide, so
+// shards should be much wider than the bodies in them. Ids, poses, queries and events
+// cover all shards, so the rest of the game sees a single world.
 class PhysXEngine {
 public:
-    PhysXEngine();
+    PhysXEngine(const PhysXEngineDesc& desc = PhysXEngineDesc());
     ~PhysXEngine();
     PhysXEngine(const PhysXEngine& other) = delete;
     PhysXEngine& operator=(const PhysXEngine& other) = delete;
@@ -18,15 +90,111 @@ public:
     void shutdown();
 
     physx::PxPhysics* getPhysics() { return physics; }
-    physx::PxScene* getScene() { return scene; }
+    physx::PxMaterial* getDefaultMaterial() { return defaultMaterial; } // used by every shape the engine makes
+    physx::PxScene* getScene(unsigned int shard = 0) { return scenes[shard]; }
+    unsigned int getNumShards() const { return static_cast<unsigned int>(scenes.size()); }
     physx::PxFoundation* getFoundation() { return foundation; }
 
-    physx::PxRigidActor* createTriangleMesh(WOPhysXActor* wo);
-    physx::PxRigidActor* createConvexMesh(WOPhysXActor* wo);
+    // hands out the stable id an actor is created under, used by recordings and replication.
+    // Ids come in call order and are never reused; callable from any thread, so the game
+    // thread knows an actor's id before the command creating it has run.
+    unsigned int reserveID() { return nextID++; }
+
+    // actors are created under an id from reserveID and tagged pudBODY
+    physx::PxRigidActor* createTriangleMesh(const PhysXMeshData& mesh, unsigned int id, const physx::PxTransform& pose);
+    physx::PxRigidActor* createConvexMesh(const PhysXMeshData& mesh, unsigned int id, const physx::PxTransform& pose);
+    // makes the shape every actor of a model and scale shares from mesh data cooked by
+    // PhysXCooking, as the first create of that model does; replays feed recorded meshes
+    // through here so the creates that follow need no geometry
+    void addCookedMesh(const std::string& fileName, const physx::PxVec3& scale, bool triangleMesh, const void* cooked, size_t size);
+    // static sphere trigger volume, its overlaps are reported to the id's trigger owner
+    physx::PxRigidActor* createTriggerSphere(unsigned int id, const physx::PxVec3& position, float radius);
+    // kinematic sphere moved by the caller (e.g. to follow the camera) so it can set off triggers,
+    // tagged pudPROXY and not registered
+    physx::PxRigidDynamic* createKinematicSphere(const physx::PxVec3& position, float radius);
+    // moves a trigger made by createTriggerSphere, along with its copies in the other shards
+    void moveTrigger(unsigned int id, const physx::PxVec3& position);
+
+    void destroyActor(unsigned int id);
+
+    physx::PxRigidActor* getActor(unsigned int id) const { return id < actorsByID.size() ? actorsByID[id] : nullptr; }
+    size_t getNumActors() const { return actorsByID.size(); } // ids registered so far, destroyed actors included
 
-    void destroyActor(physx::PxActor* actor);
+    // game thread: ties an id to the WO or listener behind it, nullptr unties it. Poses and
+    // events only reach owners through these, so an owner that unties itself before it goes
+    // away is never called again, whatever the physics thread still has queued for it.
+    void setBodyOwner(unsigned int id, WOPhysXActor* owner);
+    void setTriggerOwner(unsigned int id, PhysXTriggerListener* owner);
+    WOPhysXActor* getBodyOwner(unsigned int id) const { return id < bodyOwners.size() ? bodyOwners[id] : nullptr; }
+    // owner behind an actor's userData (e.g. from an event), nullptr if it has another tag or no owner
+    WOPhysXActor* getBodyOwner(const void* userData) const;
+    PhysXTriggerListener* getTriggerOwner(const void* userData) const;
+    // game thread: true if the next create of this model and scale has to carry its geometry,
+    // i.e. for the first one unless a current .amesh has it. Every later create finds the
+    // shape the first one cooked, since commands run in order.
+    bool needsMeshData(const std::string& fileName, const physx::PxVec3& scale, bool triangleMesh);
+    // moves a registered actor, all game side pose pushes go through here so they can be recorded
+    void setActorPose(unsigned int id, const physx::PxTransform& pose);
 
+    // writes every registered actor, with the shapes, meshes and materials it uses, to a
+    // PhysX binary collection plus a table mapping ids to their WOPhysXActor's model.
+    // models holds that model's fileName and scale indexed by id, an empty fileName for
+    // ids without one; it has to be gathered on the game thread, where WOs may be read
+    bool saveScene(const std::string& fileName, const std::vector<PhysXSceneEntry>& models);
+    // replaces registered actors with the ones saved by saveScene, deserialized in place
+    // in one block that is freed with the last of them, and returns an entry per restored
+    // actor. Actors of models whose shape is already cached share it instead of the
+    // deserialized copy of the mesh. Restored actors keep their
+    // ids, so a WOPhysXActor still owning one carries on with the restored actor; the
+    // caller builds WOs for the rest on the game thread (see WOPhysXActor::adoptPhysXActor).
+    // Actors registered after the save are left alone. Loads are not recorded, a recording
+    // spanning one won't replay.
+    bool loadScene(const std::string& fileName, std::vector<PhysXSceneEntry>& restored);
+
+    // while set, every simulation input is logged to recorder
+    void setRecorder(const std::shared_ptr<PhysXRecorder>& recorder) { this->recorder = recorder; }
+    const std::shared_ptr<PhysXRecorder>& getRecorder() const { return recorder; }
+
+    // steps the scene by dt, refills the pose store and applies the new poses to their
+    // body owners; while threaded, dt is ignored and the newest poses from the physics thread are used
     void updateSimulation(float dt);
+    // poses of every registered actor as of the last updateSimulation, game thread only
+    const PhysXPoseStore& getPoseStore() const { return poseStore; }
+
+    // runs the scene on its own thread, stepping it hz times per second
+    void startThread(float hz);
+    void stopThread();
+    bool isThreaded() const { return physicsThread.joinable(); }
+    // runs command where it may touch the scene: right away unless threaded, otherwise on
+    // the physics thread before its next step (commands run in the order they were queued)
+    void execute(const std::function<void(PhysXEngine&)>& command);
+    // runs callback on the game thread: right away unless threaded, otherwise during the
+    // game thread's next updateSimulation. Lets commands hand results back.
+    void runOnGameThread(const std::function<void()>& callback);
+
+    // scene queries against shapes in the given PHYSX_COLLISION_GROUP bits, these only
+    // read the scene and must not overlap a simulate/fetchResults call
+    bool raycast(const physx::PxVec3& origin, const physx::PxVec3& unitDir, float maxDist, PhysXQueryHit& hit,
+        physx::PxU32 groups = pcgSTATIC | pcgDYNAMIC) const;
+    bool sweep(const physx::PxGeometry& geometry, const physx::PxTransform& pose, const physx::PxVec3& unitDir, float maxDist,
+        PhysXQueryHit& hit, physx::PxU32 groups = pcgSTATIC | pcgDYNAMIC) const;
+    // writes up to maxHits userData (PhysXUserData) of overlapping actors into out, returns the number written
+    size_t overlap(const physx::PxGeometry& geometry, const physx::PxTransform& pose, void** out, size_t maxHits,
+        physx::PxU32 groups = pcgSTATIC | pcgDYNAMIC) const;
+    // runs count raycasts, split into tasks for the CPU dispatcher's workers; call it between
+    // steps, not from a task of the dispatcher
+    void raycastBatch(const PhysXRaycastQuery* queries, PhysXQueryHit* hits, size_t count,
+        physx::PxU32 groups = pcgSTATIC | pcgDYNAMIC) const;
+
+    // events generated by the last simulation steps, drained by the game thread
+    PhysXEventQueue& getEventQueue() { return eventQueue; }
+    // set which groups a group wants contact events against (PHYSX_COLLISION_GROUP bits)
+    void setContactReportMask(physx::PxU32 group, physx::PxU32 mask);
+    // enable/disable sleep and wake events for dynamic actors created afterwards
+    void setSleepEventsEnabled(bool enabled) { sleepEventsEnabled = enabled; }
+
+    // prints the number of dynamic actors in every shard and how many migrated so far
+    void printShardStats() const;
 
 private:
     physx::PxDefaultAllocator allocator;
@@ -34,12 +202,78 @@ private:
     physx::PxFoundation* foundation;
     physx::PxPhysics* physics;
     physx::PxCooking* cooking;
-    physx::PxScene* scene;
+    std::vector<physx::PxScene*> scenes; // one per shard
+    float shardWidth;
+    float shardMargin;
     physx::PxDefaultCpuDispatcher* dispatcher;
     physx::PxPvd* pvd;
     physx::PxMaterial* defaultMaterial;
 
+    PhysXEventQueue eventQueue;
+    PhysXEventCallback eventCallback;
+    std::map<physx::PxU32, physx::PxU32> contactReportMasks;
+    bool sleepEventsEnabled;
+
+    physx::PxFilterData getFilterData(physx::PxU32 group) const;
+
     std::map<ModelDataSharedID, physx::PxShape*> triangleMeshShapes;
     std::map<ModelDataSharedID, physx::PxShape*> convexMeshShapes;
+    std::set<ModelDataSharedID> requestedTriangleMeshes; // game thread, see needsMeshData
+    std::set<ModelDataSharedID> requestedConvexMeshes;
+
+    std::atomic<unsigned int> nextID;
+    std::vector<physx::PxRigidActor*> actorsByID;
+    std::unordered_map<const physx::PxActor*, unsigned int> idsByActor;
+    // per id, what the actor's userData points at; a deque so growing it never moves them
+    std::deque<PhysXUserData> userData;
+    PhysXUserData proxyUserData; // shared by every kinematic proxy
+    std::vector<WOPhysXActor*> bodyOwners; // per id, game thread only
+    std::vector<PhysXTriggerListener*> triggerOwners; // per id, game thread only
+    std::shared_ptr<PhysXRecorder> recorder;
+    PhysXPoseStore poseStore;
+
+    // copies of a static actor in the other shards, keyed by the actor in shard 0
+    std::unordered_map<const physx::PxActor*, std::vector<physx::PxRigidStatic*>> mirrors;
+    std::vector<physx::PxActor*> activeActors; // moved during the last step, all shards
+    std::vector<physx::PxActor*> restoredActors; // loaded since the last step, reported as active after it
+    physx::PxSerializationRegistry* serializationRegistry;
+    // memory a loaded scene was deserialized into and the objects in it other than actors;
+    // shared by the scene's actors, the objects are released with the last of them
+    struct LoadedScene {
+        std::unique_ptr<char[]> memory;
+        std::vector<physx::PxBase*> objects;
+    };
+    std::unordered_map<const physx::PxActor*, std::shared_ptr<LoadedScene>> loadedScenes;
+    size_t numMigrations;
+
+    // puts actor under an id from reserveID and tags its userData
+    void registerActor(physx::PxRigidActor* actor, unsigned int id, PHYSX_USER_DATA_TYPE type);
+    unsigned int getShard(const physx::PxVec3& position) const;
+    physx::PxScene* getShardScene(const physx::PxVec3& position) const { return scenes[getShard(position)]; }
+    // adds a copy of a static actor to every shard but the first
+    void mirrorStatic(physx::PxRigidStatic* actor);
+    // moves a dynamic actor to the scene of the shard it's in, once it is clear of the border
+    void migrate(physx::PxRigidActor* actor);
+
+    // simulate/fetchResults of every shard plus recording and migration, without touching any WO
+    void stepSimulation(float dt);
+
+    // fixed rate stepping, see startThread
+    std::thread physicsThread;
+    std::atomic<bool> stopping;
+    std::mutex commandMutex;
+    std::vector<std::function<void(PhysXEngine&)>> commands; // queued for the physics thread
+    std::vector<std::function<void(PhysXEngine&)>> runningCommands;
+    std::mutex callbackMutex;
+    std::vector<std::function<void()>> callbacks; // queued for the game thread
+    std::vector<std::function<void()>> runningCallbacks;
+    PhysXPoseBuffer poseBuffer;
+    unsigned int step;
+    std::vector<unsigned int> changedStep; // per actor id, last step its pose changed
+    std::vector<unsigned int> unseenIDs; // ids changed after the newest frame the game thread read
+    unsigned int unseenThrough; // consumed step unseenIDs was last pruned against
+
+    void runPhysicsThread(float hz);
+    void publishPoses(); // physics thread, fills and publishes the next pose frame
 };
 }
\ No newline at end of file
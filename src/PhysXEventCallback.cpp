@@ -0,0 +1,100 @@
+#include "PhysXEventCallback.h"
+
+#include "PhysXEventQueue.h"
+
+using namespace Aftr;
+using namespace physx;
+
+PhysXEventCallback::PhysXEventCallback(PhysXEventQueue& queue)
+    : queue(queue)
+{
+}
+
+PxFilterFlags PhysXEventCallback::filterShader(PxFilterObjectAttributes attributes0, PxFilterData filterData0,
+    PxFilterObjectAttributes attributes1, PxFilterData filterData1,
+    PxPairFlags& pairFlags, const void* constantBlock, PxU32 constantBlockSize)
+{
+    PX_UNUSED(constantBlock);
+    PX_UNUSED(constantBlockSize);
+
+    // triggers only ever need touch found/lost
+    if (PxFilterObjectIsTrigger(attributes0) || PxFilterObjectIsTrigger(attributes1)) {
+        pairFlags = PxPairFlag::eTRIGGER_DEFAULT;
+        return PxFilterFlag::eDEFAULT;
+    }
+
+    // proxies never touch anything physically
+    if ((filterData0.word0 | filterData1.word0) & pcgPROXY)
+        return PxFilterFlag::eSUPPRESS;
+
+    // CCD contacts only happen for bodies with PxRigidBodyFlag::eENABLE_CCD
+    pairFlags = PxPairFlag::eCONTACT_DEFAULT | PxPairFlag::eDETECT_CCD_CONTACT;
+    if ((filterData0.word0 & filterData1.word1) || (filterData1.word0 & filterData0.word1))
+        pairFlags |= PxPairFlag::eNOTIFY_TOUCH_FOUND | PxPairFlag::eNOTIFY_CONTACT_POINTS;
+
+    return PxFilterFlag::eDEFAULT;
+}
+
+void PhysXEventCallback::onConstraintBreak(PxConstraintInfo* constraints, PxU32 count)
+{
+    PX_UNUSED(constraints);
+    PX_UNUSED(count);
+}
+
+void PhysXEventCallback::onWake(PxActor** actors, PxU32 count)
+{
+    for (PxU32 i = 0; i < count; ++i) {
+        queue.push({ PHYSX_EVENT_TYPE::peWAKE, actors[i]->userData, nullptr, PxVec3(0.0f), 0.0f });
+    }
+}
+
+void PhysXEventCallback::onSleep(PxActor** actors, PxU32 count)
+{
+    for (PxU32 i = 0; i < count; ++i) {
+        queue.push({ PHYSX_EVENT_TYPE::peSLEEP, actors[i]->userData, nullptr, PxVec3(0.0f), 0.0f });
+    }
+}
+
+void PhysXEventCallback::onContact(const PxContactPairHeader& pairHeader, const PxContactPair* pairs, PxU32 nbPairs)
+{
+    if (pairHeader.flags & (PxContactPairHeaderFlag::eREMOVED_ACTOR_0 | PxContactPairHeaderFlag::eREMOVED_ACTOR_1))
+        return;
+
+    // a few points are enough to place the event and estimate its strength
+    const PxU32 maxPoints = 4;
+    PxContactPairPoint points[maxPoints];
+
+    for (PxU32 i = 0; i < nbPairs; ++i) {
+        const PxContactPair& pair = pairs[i];
+        if (!(pair.events & PxPairFlag::eNOTIFY_TOUCH_FOUND))
+            continue;
+
+        PxU32 numPoints = pair.extractContacts(points, maxPoints);
+        PhysXEvent e = { PHYSX_EVENT_TYPE::peCONTACT, pairHeader.actors[0]->userData, pairHeader.actors[1]->userData, PxVec3(0.0f), 0.0f };
+        if (numPoints > 0)
+            e.position = points[0].position;
+        for (PxU32 j = 0; j < numPoints; ++j) {
+            e.impulse += points[j].impulse.magnitude();
+        }
+        queue.push(e);
+    }
+}
+
+void PhysXEventCallback::onTrigger(PxTriggerPair* pairs, PxU32 count)
+{
+    for (PxU32 i = 0; i < count; ++i) {
+        const PxTriggerPair& pair = pairs[i];
+        if (pair.flags & (PxTriggerPairFlag::eREMOVED_SHAPE_TRIGGER | PxTriggerPairFlag::eREMOVED_SHAPE_OTHER))
+            continue;
+
+        PHYSX_EVENT_TYPE type = pair.status == PxPairFlag::eNOTIFY_TOUCH_FOUND ? PHYSX_EVENT_TYPE::peTRIGGER_ENTER : PHYSX_EVENT_TYPE::peTRIGGER_EXIT;
+        queue.push({ type, pair.triggerActor->userData, pair.otherActor->userData, PxVec3(0.0f), 0.0f });
+    }
+}
+
+void PhysXEventCallback::onAdvance(const PxRigidBody* const* bodyBuffer, const PxTransform* poseBuffer, const PxU32 count)
+{
+    PX_UNUSED(bodyBuffer);
+    PX_UNUSED(poseBuffer);
+    PX_UNUSED(count);
+}
\ No newline at end of file
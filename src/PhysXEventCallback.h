@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+class PhysXEventQueue;
+
+// collision groups stored in word0 of a shape's simulation filter data;
+// word1 holds the mask of groups this shape wants contact reports against
+enum PHYSX_COLLISION_GROUP : physx::PxU32 {
+    pcgSTATIC = 1 << 0,
+    pcgDYNAMIC = 1 << 1,
+    pcgTRIGGER = 1 << 2,
+    pcgPROXY = 1 << 3 // kinematic proxies that only set off triggers
+};
+
+// Receives simulation events from PhysX during simulate/fetchResults and
+// copies them into a PhysXEventQueue. Nothing here allocates or calls into
+// game code, so the cost per contact is a handful of stores.
+class PhysXEventCallback : public physx::PxSimulationEventCallback {
+public:
+    explicit PhysXEventCallback(PhysXEventQueue& queue);
+
+    // filter shader that only requests contact reports for group pairs whose
+    // masks ask for them, so PhysX never generates the ones nobody reads
+    static physx::PxFilterFlags filterShader(physx::PxFilterObjectAttributes attributes0, physx::PxFilterData filterData0,
+        physx::PxFilterObjectAttributes attributes1, physx::PxFilterData filterData1,
+        physx::PxPairFlags& pairFlags, const void* constantBlock, physx::PxU32 constantBlockSize);
+
+    virtual void onConstraintBreak(physx::PxConstraintInfo* constraints, physx::PxU32 count);
+    virtual void onWake(physx::PxActor** actors, physx::PxU32 count);
+    virtual void onSleep(physx::PxActor** actors, physx::PxU32 count);
+    virtual void onContact(const physx::PxContactPairHeader& pairHeader, const physx::PxContactPair* pairs, physx::PxU32 nbPairs);
+    virtual void onTrigger(physx::PxTriggerPair* pairs, physx::PxU32 count);
+    virtual void onAdvance(const physx::PxRigidBody* const* bodyBuffer, const physx::PxTransform* poseBuffer, const physx::PxU32 count);
+
+private:
+    PhysXEventQueue& queue;
+};
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "PhysXEventQueue.h"
+
+#include <algorithm>
+
+using namespace Aftr;
+
+PhysXEventQueue::PhysXEventQueue(size_t capacity)
+{
+    // round capacity up to a power of two so indices can be masked
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+
+    buffer.resize(size);
+    mask = size - 1;
+    head = 0;
+    tail = 0;
+    dropped = 0;
+}
+
+bool PhysXEventQueue::push(const PhysXEvent& e)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= buffer.size()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    buffer[h & mask] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+size_t PhysXEventQueue::drain(std::vector<PhysXEvent>& out)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    size_t count = h - t;
+
+    out.resize(count);
+    if (count > 0) {
+        // copy in at most two contiguous runs (before and after wrapping)
+        size_t start = t & mask;
+        size_t first = std::min(count, buffer.size() - start);
+        std::copy(buffer.begin() + start, buffer.begin() + start + first, out.begin());
+        std::copy(buffer.begin(), buffer.begin() + (count - first), out.begin() + first);
+    }
+
+    tail.store(h, std::memory_order_release);
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+enum class PHYSX_EVENT_TYPE : unsigned char {
+    peCONTACT,
+    peTRIGGER_ENTER,
+    peTRIGGER_EXIT,
+    peSLEEP,
+    peWAKE
+};
+
+// a single simulation event, small enough to be copied around by value
+struct PhysXEvent {
+    PHYSX_EVENT_TYPE type;
+    void* a; // userData (a PhysXUserData) of first actor, the trigger for trigger events
+    void* b; // userData of second actor (nullptr for sleep/wake events)
+    physx::PxVec3 position; // first contact point (contact events only)
+    float impulse; // summed impulse magnitude of the reported contact points
+};
+
+// Preallocated single producer/single consumer ring buffer of simulation events.
+// The producer is whichever thread calls fetchResults, the consumer is the game
+// thread, which drains everything that has been queued in one batch.
+class PhysXEventQueue {
+public:
+    explicit PhysXEventQueue(size_t capacity = 4096);
+    PhysXEventQueue(const PhysXEventQueue& other) = delete;
+    PhysXEventQueue& operator=(const PhysXEventQueue& other) = delete;
+
+    // producer side, returns false (and counts a drop) if the queue is full
+    bool push(const PhysXEvent& e);
+    // consumer side, replaces the contents of out with every queued event;
+    // out keeps its capacity between calls so steady state draining does not allocate
+    size_t drain(std::vector<PhysXEvent>& out);
+
+    size_t getCapacity() const { return buffer.size(); }
+    size_t getNumDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<PhysXEvent> buffer;
+    size_t mask;
+    std::atomic<size_t> head; // next slot to write, only modified by producer
+    std::atomic<size_t> tail; // next slot to read, only modified by consumer
+    std::atomic<size_t> dropped;
+};
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "PhysXLODManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "PhysXEngine.h"
+
+using namespace Aftr;
+using namespace physx;
+
+// levels of actors that haven't been evaluated yet
+static const unsigned char unknownLevel = plNUM_LEVELS;
+// solver position iterations per level, velocity iterations always stay at 1
+static const PxU32 positionIterations[plNUM_LEVELS] = { 4, 2, 1, 1 };
+
+PhysXLODManager::PhysXLODManager(const PhysXLODDesc& desc)
+    : desc(desc)
+{
+    nextID = 0;
+}
+
+PhysXLODManager::~PhysXLODManager()
+{
+    // bodies still using a proxy keep their own reference to it
+    for (auto& p : proxies) {
+        p.second->release();
+    }
+}
+
+PHYSX_LOD_LEVEL PhysXLODManager::getLevel(float distance) const
+{
+    if (distance >= desc.freezeDistance)
+        return plFROZEN;
+    if (distance >= desc.farDistance)
+        return plFAR;
+    if (distance >= desc.midDistance)
+        return plMID;
+    return plNEAR;
+}
+
+void PhysXLODManager::update(PhysXEngine& engine, const std::vector<PxVec3>& viewers)
+{
+    size_t numActors = engine.getNumActors();
+    levels.resize(numActors, unknownLevel);
+    if (numActors == 0 || viewers.empty())
+        return;
+
+    float restSpeedSquared = desc.restSpeed * desc.restSpeed;
+    size_t count = std::min(size_t(desc.actorsPerUpdate), numActors);
+    for (size_t n = 0; n < count; ++n) {
+        unsigned int id = nextID;
+        nextID = (nextID + 1) % numActors;
+
+        PxRigidActor* actor = engine.getActor(id);
+        PxRigidDynamic* body = actor != nullptr ? actor->is<PxRigidDynamic>() : nullptr;
+        // kinematics that we didn't freeze are moved by someone else
+        if (body == nullptr || (levels[id] != plFROZEN && (body->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC)))
+            continue;
+
+        PxVec3 p = body->getGlobalPose().p;
+        float distanceSquared = PX_MAX_F32;
+        for (const PxVec3& v : viewers) {
+            distanceSquared = std::min(distanceSquared, (p - v).magnitudeSquared());
+        }
+        float distance = std::sqrt(distanceSquared);
+
+        PHYSX_LOD_LEVEL current = PHYSX_LOD_LEVEL(levels[id]);
+        PHYSX_LOD_LEVEL target = getLevel(distance);
+        // only coarsen once clearly past a boundary, so bodies sitting on it don't flip every update
+        if (current != unknownLevel && target > current && getLevel(distance / 1.1f) <= current)
+            target = current;
+        if (target != current) {
+            setLevel(engine, body, current, target);
+            levels[id] = target;
+        }
+
+        if ((target == plMID || target == plFAR) && !body->isSleeping() && body->getLinearVelocity().magnitudeSquared() < restSpeedSquared
+            && body->getAngularVelocity().magnitudeSquared() < restSpeedSquared)
+            body->putToSleep();
+    }
+}
+
+void PhysXLODManager::reset(PhysXEngine& engine)
+{
+    for (unsigned int id = 0; id < levels.size(); ++id) {
+        if (levels[id] == unknownLevel || levels[id] == plNEAR)
+            continue;
+        PxRigidActor* actor = engine.getActor(id);
+        if (PxRigidDynamic* body = actor != nullptr ? actor->is<PxRigidDynamic>() : nullptr)
+            setLevel(engine, body, PHYSX_LOD_LEVEL(levels[id]), plNEAR);
+    }
+    levels.assign(levels.size(), unknownLevel);
+    nextID = 0;
+
+    // nothing uses a proxy anymore, and the full shapes they stand in for may be released
+    // along with a loaded scene, so their pointers could be handed out again
+    for (auto& p : proxies) {
+        p.second->release();
+    }
+    proxies.clear();
+    fullShapes.clear();
+}
+
+void PhysXLODManager::setLevel(PhysXEngine& engine, PxRigidDynamic* body, PHYSX_LOD_LEVEL from, PHYSX_LOD_LEVEL to)
+{
+    if (to == plFROZEN) {
+        // CCD isn't allowed on kinematics; the shape stays whatever it was
+        body->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, false);
+        body->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
+        return;
+    }
+    if (from == plFROZEN) {
+        // it may have been frozen mid flight, let it settle
+        body->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, false);
+        body->wakeUp();
+    }
+
+    body->setSolverIterationCounts(positionIterations[to], 1);
+    body->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, to == plNEAR);
+    setProxy(engine, body, to == plFAR);
+}
+
+void PhysXLODManager::setProxy(PhysXEngine& engine, PxRigidDynamic* body, bool useProxy)
+{
+    PxShape* shape = nullptr;
+    if (body->getNbShapes() != 1 || body->getShapes(&shape, 1) != 1)
+        return;
+    bool isProxy = fullShapes.count(shape) != 0;
+    if (isProxy == useProxy)
+        return;
+
+    PxShape* replacement = nullptr;
+    if (useProxy) {
+        auto it = proxies.find(shape);
+        if (it == proxies.end()) {
+            // only convex hulls get a proxy, anything else is already cheap
+            PxConvexMeshGeometry convex;
+            if (!shape->getConvexMeshGeometry(convex))
+                return;
+
+            // not the shape's own material, which a loaded scene may release while the proxy lives on
+            PxBounds3 bounds = convex.convexMesh->getLocalBounds();
+            PxShape* proxy = engine.getPhysics()->createShape(PxBoxGeometry(bounds.getExtents()), *engine.getDefaultMaterial());
+            proxy->setLocalPose(PxTransform(bounds.getCenter()));
+            proxy->setSimulationFilterData(shape->getSimulationFilterData());
+            proxy->setQueryFilterData(shape->getQueryFilterData());
+            it = proxies.insert(std::make_pair(shape, proxy)).first;
+            fullShapes.insert(std::make_pair(proxy, shape));
+        }
+        replacement = it->second;
+    } else {
+        replacement = fullShapes[shape];
+    }
+
+    // mass properties are left alone, so swapping doesn't change how the body moves
+    body->detachShape(*shape);
+    body->attachShape(*replacement);
+}
+
+void PhysXLODManager::printStats() const
+{
+    size_t counts[plNUM_LEVELS + 1] = {};
+    for (unsigned char level : levels) {
+        ++counts[level];
+    }
+    std::cout << "PhysX LOD | near " << counts[plNEAR] << " | mid " << counts[plMID] << " | far " << counts[plFAR]
+              << " | frozen " << counts[plFROZEN] << " | unevaluated " << counts[unknownLevel] << std::endl;
+}
\ No newline at end of file
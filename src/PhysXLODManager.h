@@ -0,0 +1,60 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+class PhysXEngine;
+
+// physics levels of detail, from full fidelity to not simulated at all
+enum PHYSX_LOD_LEVEL : unsigned char {
+    plNEAR = 0, // default solver iterations, continuous collision detection
+    plMID, // fewer solver iterations, put to sleep as soon as it is nearly at rest
+    plFAR, // minimal solver iterations, box proxy instead of the convex hull, early sleep
+    plFROZEN, // kinematic, stays where it is until a viewer comes closer
+    plNUM_LEVELS
+};
+
+// tuning of PhysXLODManager, distances are from the closest viewer
+struct PhysXLODDesc {
+    float midDistance = 60.0f;
+    float farDistance = 150.0f;
+    float freezeDistance = 400.0f;
+    float restSpeed = 0.1f; // linear and angular speed below which plMID and coarser bodies are put to sleep
+    unsigned int actorsPerUpdate = 256; // actors re-evaluated per update, round robin
+};
+
+// Adjusts the simulation fidelity of every registered dynamic actor of a PhysXEngine
+// by its distance from the viewers, so the step cost follows what is close enough
+// to matter instead of the total body count. Touches the scene, so update must run
+// where the scene may be touched (see PhysXEngine::execute).
+class PhysXLODManager {
+public:
+    explicit PhysXLODManager(const PhysXLODDesc& desc = PhysXLODDesc());
+    ~PhysXLODManager();
+    PhysXLODManager(const PhysXLODManager& other) = delete;
+    PhysXLODManager& operator=(const PhysXLODManager& other) = delete;
+
+    // re-evaluates the next actorsPerUpdate actors against viewers
+    void update(PhysXEngine& engine, const std::vector<physx::PxVec3>& viewers);
+    // brings every actor back to full fidelity and forgets all levels and proxies, e.g. so
+    // a scene checkpoint doesn't capture proxies or frozen bodies, or before one is loaded
+    void reset(PhysXEngine& engine);
+    // number of actors currently at each PHYSX_LOD_LEVEL
+    void printStats() const;
+
+private:
+    PhysXLODDesc desc;
+    std::vector<unsigned char> levels; // per actor id
+    unsigned int nextID; // round robin cursor
+    std::unordered_map<physx::PxShape*, physx::PxShape*> proxies; // full shape -> box proxy
+    std::unordered_map<physx::PxShape*, physx::PxShape*> fullShapes; // box proxy -> full shape
+
+    PHYSX_LOD_LEVEL getLevel(float distance) const;
+    void setLevel(PhysXEngine& engine, physx::PxRigidDynamic* body, PHYSX_LOD_LEVEL from, PHYSX_LOD_LEVEL to);
+    // swaps the body's only shape between its full geometry and a box proxy of the same bounds
+    void setProxy(PhysXEngine& engine, physx::PxRigidDynamic* body, bool useProxy);
+};
+}
\ No newline at end of file
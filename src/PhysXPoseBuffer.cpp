@@ -0,0 +1,34 @@
+#include "PhysXPoseBuffer.h"
+
+using namespace Aftr;
+
+void PhysXPoseFrame::clear()
+{
+    ids.clear();
+    poses.clear();
+    linearVelocities.clear();
+}
+
+PhysXPoseBuffer::PhysXPoseBuffer()
+{
+    writeIndex = 0;
+    middle = 1;
+    readIndex = 2;
+    consumedStep = 0;
+}
+
+void PhysXPoseBuffer::publish()
+{
+    // swap the finished frame into the middle and continue with whatever was there
+    writeIndex = middle.exchange(writeIndex | NEW_FRAME, std::memory_order_acq_rel) & ~NEW_FRAME;
+}
+
+const PhysXPoseFrame* PhysXPoseBuffer::acquire()
+{
+    if (!(middle.load(std::memory_order_relaxed) & NEW_FRAME))
+        return nullptr;
+
+    readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & ~NEW_FRAME;
+    consumedStep.store(frames[readIndex].step, std::memory_order_release);
+    return &frames[readIndex];
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+// poses of the actors that changed since the consumer's last frame, as parallel arrays
+struct PhysXPoseFrame {
+    unsigned int step = 0; // simulation step the poses belong to
+    std::vector<unsigned int> ids; // PhysXEngine actor ids
+    std::vector<physx::PxTransform> poses;
+    std::vector<physx::PxVec3> linearVelocities;
+
+    void clear();
+};
+
+// Lock free triple buffer handing pose frames from the physics thread to the
+// game thread. The producer always has a frame to write and the consumer always
+// gets the newest complete one; neither ever waits for the other. Frames the
+// consumer never saw are superseded, which is why the producer keeps putting an
+// actor into every frame until getConsumedStep says a frame with it was read.
+class PhysXPoseBuffer {
+public:
+    PhysXPoseBuffer();
+    PhysXPoseBuffer(const PhysXPoseBuffer& other) = delete;
+    PhysXPoseBuffer& operator=(const PhysXPoseBuffer& other) = delete;
+
+    // producer side, the frame to fill next; publish hands it over
+    PhysXPoseFrame& getWriteFrame() { return frames[writeIndex]; }
+    void publish();
+    // step of the newest frame the consumer has acquired, 0 if none
+    unsigned int getConsumedStep() const { return consumedStep.load(std::memory_order_acquire); }
+
+    // consumer side, the newest published frame or nullptr if nothing was published
+    // since the last call; the frame stays valid until the next call
+    const PhysXPoseFrame* acquire();
+
+private:
+    static const unsigned int NEW_FRAME = 4; // set in middle while it holds an unread frame
+
+    PhysXPoseFrame frames[3];
+    unsigned int writeIndex; // only touched by the producer
+    unsigned int readIndex; // only touched by the consumer
+    std::atomic<unsigned int> middle; // index of the frame in between, plus NEW_FRAME
+    std::atomic<unsigned int> consumedStep;
+};
+}
\ No newline at end of file
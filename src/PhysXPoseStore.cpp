@@ -0,0 +1,36 @@
+#include "PhysXPoseStore.h"
+
+#include <algorithm>
+
+using namespace Aftr;
+using namespace physx;
+
+void PhysXPoseStore::clearDirty()
+{
+    // only the flags that were set, not the whole array
+    for (unsigned int id : dirtyIDs) {
+        dirty[id] = 0;
+    }
+    dirtyIDs.clear();
+}
+
+void PhysXPoseStore::set(unsigned int id, const PxTransform& pose, const PxVec3& linearVelocity)
+{
+    if (id >= positions.size()) {
+        // ids are handed out in order, so this grows by about one actor at a time;
+        // doubling keeps it from reallocating every spawn
+        size_t size = std::max(size_t(id) + 1, positions.size() * 2);
+        positions.resize(size, PxVec3(0.0f));
+        rotations.resize(size, PxQuat(PxIdentity));
+        linearVelocities.resize(size, PxVec3(0.0f));
+        dirty.resize(size, 0);
+    }
+
+    positions[id] = pose.p;
+    rotations[id] = pose.q;
+    linearVelocities[id] = linearVelocity;
+    if (!dirty[id]) {
+        dirty[id] = 1;
+        dirtyIDs.push_back(id);
+    }
+}
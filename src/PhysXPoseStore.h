@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+// Newest pose of every registered actor as parallel arrays indexed by PhysXEngine
+// actor id. PhysXEngine refills it in one pass over the actors that moved, and the
+// ids it touched are listed in getDirtyIDs, so consumers (rendering, replication)
+// walk those in bulk instead of being called back once per actor.
+class PhysXPoseStore {
+public:
+    PhysXPoseStore() = default;
+    PhysXPoseStore(const PhysXPoseStore& other) = delete;
+    PhysXPoseStore& operator=(const PhysXPoseStore& other) = delete;
+
+    // forgets which ids were dirty, called before every refill
+    void clearDirty();
+    // stores an actor's pose and marks its id dirty, growing the arrays as needed
+    void set(unsigned int id, const physx::PxTransform& pose, const physx::PxVec3& linearVelocity);
+
+    size_t size() const { return positions.size(); } // ids with a slot, see PhysXEngine::getBodyOwner for who they belong to
+    // ids changed by the last refill, in the order they were stored
+    const std::vector<unsigned int>& getDirtyIDs() const { return dirtyIDs; }
+    bool isDirty(unsigned int id) const { return id < dirty.size() && dirty[id] != 0; }
+
+    const physx::PxVec3& getPosition(unsigned int id) const { return positions[id]; }
+    const physx::PxQuat& getRotation(unsigned int id) const { return rotations[id]; }
+    const physx::PxVec3& getLinearVelocity(unsigned int id) const { return linearVelocities[id]; }
+
+private:
+    std::vector<physx::PxVec3> positions;
+    std::vector<physx::PxQuat> rotations;
+    std::vector<physx::PxVec3> linearVelocities;
+    std::vector<unsigned char> dirty; // 1 while the id is in dirtyIDs
+    std::vector<unsigned int> dirtyIDs;
+};
+}
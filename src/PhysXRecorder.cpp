@@ -0,0 +1,129 @@
+#include "PhysXRecorder.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace Aftr;
+using namespace physx;
+
+// buffered bytes before the recording is written out to disk
+static const size_t flushThreshold = 1 << 16;
+
+PhysXRecorder::PhysXRecorder(const std::string& fileName, unsigned int numShards, float shardWidth, unsigned int checkpointInterval)
+    : file(fileName, std::ios::binary | std::ios::trunc)
+{
+    this->checkpointInterval = checkpointInterval;
+    numSteps = 0;
+    buffer.reserve(flushThreshold * 2);
+
+    if (file.is_open()) {
+        write(static_cast<unsigned int>(MAGIC));
+        write(static_cast<unsigned int>(VERSION));
+        write(numShards);
+        write(shardWidth);
+        std::cout << "Recording PhysX simulation to " << fileName << std::endl;
+    } else {
+        std::cout << "Failed to open PhysX recording " << fileName << std::endl;
+    }
+}
+
+PhysXRecorder::~PhysXRecorder()
+{
+    flush();
+}
+
+template <typename T>
+void PhysXRecorder::write(const T& value)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(T));
+    std::memcpy(&buffer[offset], &value, sizeof(T));
+}
+
+void PhysXRecorder::writePose(const PxTransform& pose)
+{
+    write(pose.p.x);
+    write(pose.p.y);
+    write(pose.p.z);
+    write(pose.q.x);
+    write(pose.q.y);
+    write(pose.q.z);
+    write(pose.q.w);
+}
+
+void PhysXRecorder::recordMesh(PHYSX_RECORD_MESH_TYPE type, const std::string& path, const PxVec3& scale, const void* cooked, size_t size)
+{
+    write(rtMESH);
+    write(type);
+    write(static_cast<unsigned int>(path.size()));
+    buffer.insert(buffer.end(), path.begin(), path.end());
+    write(scale.x);
+    write(scale.y);
+    write(scale.z);
+    write(static_cast<unsigned int>(size));
+    const char* bytes = static_cast<const char*>(cooked);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void PhysXRecorder::recordCreate(PHYSX_RECORD_MESH_TYPE type, unsigned int id, const PxTransform& pose, const std::string& path,
+    const PxVec3& scale)
+{
+    write(rtCREATE);
+    write(type);
+    write(id);
+    writePose(pose);
+    write(static_cast<unsigned int>(path.size()));
+    buffer.insert(buffer.end(), path.begin(), path.end());
+    write(scale.x);
+    write(scale.y);
+    write(scale.z);
+}
+
+void PhysXRecorder::recordPush(unsigned int id, const PxTransform& pose)
+{
+    write(rtPUSH);
+    write(id);
+    writePose(pose);
+}
+
+void PhysXRecorder::recordStep(float dt)
+{
+    write(rtSTEP);
+    write(dt);
+    ++numSteps;
+
+    if (buffer.size() >= flushThreshold)
+        flush();
+}
+
+void PhysXRecorder::recordCheckpoint(const std::vector<PxRigidActor*>& actorsByID)
+{
+    if (checkpointInterval == 0 || numSteps % checkpointInterval != 0)
+        return;
+
+    write(rtCHECKPOINT);
+    write(numSteps);
+
+    // count is patched in once the dynamic actors have been written
+    size_t countOffset = buffer.size();
+    unsigned int count = 0;
+    write(count);
+    for (size_t i = 0; i < actorsByID.size(); ++i) {
+        PxRigidActor* actor = actorsByID[i];
+        if (actor != nullptr && actor->is<PxRigidDynamic>() != nullptr) {
+            write(static_cast<unsigned int>(i));
+            writePose(actor->getGlobalPose());
+            ++count;
+        }
+    }
+    std::memcpy(&buffer[countOffset], &count, sizeof(count));
+}
+
+void PhysXRecorder::flush()
+{
+    if (file.is_open() && !buffer.empty()) {
+        file.write(buffer.data(), std::streamsize(buffer.size()));
+        file.flush();
+    }
+    buffer.clear();
+}
\ No newline at end of file
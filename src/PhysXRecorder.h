@@ -0,0 +1,70 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "PxPhysicsAPI.h"
+
+namespace Aftr {
+// Record types of a PhysX recording. A recording is a small header (u32 magic,
+// u32 version, u32 shard count, float shard width; the engine layout the replay
+// has to rebuild) followed by a flat sequence of [type byte][payload] records in
+// native (little endian) byte order:
+//   rtPUSH       u32 actor id, 3 floats position, 4 floats quaternion (x, y, z, w)
+//   rtSTEP       float dt
+//   rtCHECKPOINT u32 step index, u32 count, count * (u32 actor id, 7 floats pose)
+//   rtMESH       u8 mesh type, u32 path length, path bytes, 3 floats scale, u32 size, size bytes
+//                of cooked PhysX mesh; written when a model's shape is first made
+//   rtCREATE     u8 mesh type, u32 actor id, 7 floats pose, u32 path length, path bytes, 3 floats scale
+enum PHYSX_RECORD_TYPE : unsigned char {
+    rtPUSH = 2,
+    rtSTEP = 3,
+    rtCHECKPOINT = 4,
+    rtMESH = 5,
+    rtCREATE = 6
+};
+
+enum PHYSX_RECORD_MESH_TYPE : unsigned char {
+    rmTRIANGLE_MESH = 0, // static, PhysXEngine::createTriangleMesh
+    rmCONVEX_MESH = 1 // dynamic, PhysXEngine::createConvexMesh
+};
+
+// Logs every input to the simulation into a compact binary file so a run can
+// be replayed offline by PhysXReplayer. Actors are logged as PhysXEngine creates
+// them, along with the cooked meshes they use, so a replay needs neither the
+// model files nor any WOs. Triggers and kinematic proxies are not logged, they
+// never move a body.
+class PhysXRecorder {
+public:
+    static const unsigned int MAGIC = 0x52585041; // "APXR"
+    static const unsigned int VERSION = 4; // 4: shard layout in the header
+
+    PhysXRecorder(const std::string& fileName, unsigned int numShards, float shardWidth, unsigned int checkpointInterval = 60);
+    ~PhysXRecorder();
+    PhysXRecorder(const PhysXRecorder& other) = delete;
+    PhysXRecorder& operator=(const PhysXRecorder& other) = delete;
+
+    bool isOpen() const { return file.is_open(); }
+
+    void recordMesh(PHYSX_RECORD_MESH_TYPE type, const std::string& path, const physx::PxVec3& scale, const void* cooked, size_t size);
+    void recordCreate(PHYSX_RECORD_MESH_TYPE type, unsigned int id, const physx::PxTransform& pose, const std::string& path,
+        const physx::PxVec3& scale);
+    void recordPush(unsigned int id, const physx::PxTransform& pose);
+    void recordStep(float dt);
+    // writes the pose of every non-null dynamic actor in actorsByID, if a checkpoint is due
+    void recordCheckpoint(const std::vector<physx::PxRigidActor*>& actorsByID);
+
+    void flush();
+
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    unsigned int checkpointInterval;
+    unsigned int numSteps;
+
+    template <typename T>
+    void write(const T& value);
+    void writePose(const physx::PxTransform& pose);
+};
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "PhysXReplayer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "LZCompressor.h"
+#include "PhysXEngine.h"
+#include "PhysXRecorder.h"
+#include "PoseStreamCompressor.h"
+#include "PoseWire.h"
+#include "WOPhysXActor.h"
+
+using namespace Aftr;
+using namespace physx;
+
+PhysXReplayer::PhysXReplayer(const std::string& fileName)
+{
+    cursor = 0;
+    valid = false;
+    numShards = 1;
+    shardWidth = 0.0f;
+
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        std::cout << "Failed to open PhysX recording " << fileName << std::endl;
+        return;
+    }
+    data.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), std::streamsize(data.size()));
+
+    unsigned int magic = 0, version = 0;
+    valid = read(magic) && read(version) && magic == PhysXRecorder::MAGIC && version == PhysXRecorder::VERSION
+        && read(numShards) && read(shardWidth) && numShards > 0 && shardWidth > 0.0f;
+    if (!valid)
+        std::cout << "Invalid PhysX recording " << fileName << std::endl;
+}
+
+template <typename T>
+bool PhysXReplayer::read(T& value)
+{
+    if (cursor + sizeof(T) > data.size())
+        return false;
+    std::memcpy(&value, &data[cursor], sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+bool PhysXReplayer::readString(std::string& value)
+{
+    unsigned int length = 0;
+    if (!read(length) || length > data.size() - cursor)
+        return false;
+    value.assign(&data[cursor], length);
+    cursor += length;
+    return true;
+}
+
+bool PhysXReplayer::run()
+{
+    using namespace std::chrono;
+
+    if (!valid)
+        return false;
+
+    PhysXEngineDesc desc;
+    desc.enhancedDeterminism = true;
+    desc.numShards = numShards;
+    desc.shardWidth = shardWidth;
+    PhysXEngine engine(desc);
+
+    std::vector<double> stepTimes;
+    unsigned int numCheckpoints = 0;
+    unsigned int firstDivergentStep = 0;
+    bool diverged = false;
+    float maxError = 0.0f;
+
+    // what a session with an unlimited budget would send every step; records carry
+    // actor ids where a real session sends model ids, which compresses the same
+    PoseStreamCompressor poseEncoder;
+    std::string records, lz, pose;
+    size_t rawBytes = 0, lzBytes = 0, poseBytes = 0;
+    double lzMs = 0.0, poseMs = 0.0;
+
+    auto readVec = [this](PxVec3& v) { return read(v.x) && read(v.y) && read(v.z); };
+    auto readPose = [this, &readVec](PxTransform& t) { return readVec(t.p) && read(t.q.x) && read(t.q.y) && read(t.q.z) && read(t.q.w); };
+
+    auto start = steady_clock::now();
+    bool malformed = false;
+    unsigned char type = 0;
+    while (read(type)) {
+        size_t recordStart = cursor - 1;
+        if (type == rtMESH) {
+            unsigned char meshType = 0;
+            std::string path;
+            PxVec3 scale;
+            unsigned int size = 0;
+            malformed = !(read(meshType) && readString(path) && readVec(scale) && read(size) && size <= data.size() - cursor);
+            if (!malformed) {
+                engine.addCookedMesh(path, scale, meshType == rmTRIANGLE_MESH, &data[cursor], size);
+                cursor += size;
+            }
+        } else if (type == rtCREATE) {
+            unsigned char meshType = 0;
+            unsigned int id = 0;
+            PxTransform t;
+            PhysXMeshData mesh;
+            malformed = !(read(meshType) && read(id) && readPose(t) && readString(mesh.fileName) && readVec(mesh.scale));
+            // the mesh was recorded ahead of its first create, so this never cooks
+            if (!malformed && (meshType == rmTRIANGLE_MESH ? engine.createTriangleMesh(mesh, id, t) : engine.createConvexMesh(mesh, id, t)) == nullptr) {
+                std::cout << "Failed to recreate actor " << id << " (" << mesh.fileName << ") at byte " << recordStart
+                          << " of the PhysX recording, stopping replay" << std::endl;
+                return false;
+            }
+        } else if (type == rtPUSH) {
+            unsigned int id = 0;
+            PxTransform t;
+            malformed = !(read(id) && readPose(t));
+            if (!malformed)
+                engine.setActorPose(id, t);
+        } else if (type == rtSTEP) {
+            float dt = 0.0f;
+            malformed = !read(dt);
+            if (!malformed) {
+                auto before = steady_clock::now();
+                engine.updateSimulation(dt);
+                stepTimes.push_back(duration_cast<duration<double, std::milli>>(steady_clock::now() - before).count());
+
+                records.clear();
+                const PhysXPoseStore& store = engine.getPoseStore();
+                for (unsigned int id : store.getDirtyIDs()) {
+                    char record[sizeof(PoseWire)];
+                    const PxVec3& p = store.getPosition(id);
+                    PoseWire::encode(record, id, WOPhysXActor::toDisplayMatrix(store.getRotation(id)), Vector(p.x, p.y, p.z));
+                    records.append(record, sizeof(record));
+                }
+                if (!records.empty()) {
+                    lz.clear();
+                    pose.clear();
+                    auto lzBefore = steady_clock::now();
+                    LZCompressor::compress(records.data(), records.size(), lz);
+                    auto middle = steady_clock::now();
+                    poseEncoder.compress(records.data(), static_cast<unsigned int>(store.getDirtyIDs().size()), pose);
+                    auto after = steady_clock::now();
+                    rawBytes += records.size();
+                    lzBytes += lz.size();
+                    poseBytes += pose.size();
+                    lzMs += duration_cast<duration<double, std::milli>>(middle - lzBefore).count();
+                    poseMs += duration_cast<duration<double, std::milli>>(after - middle).count();
+                }
+            }
+        } else if (type == rtCHECKPOINT) {
+            unsigned int step = 0, count = 0;
+            malformed = !(read(step) && read(count));
+            for (unsigned int i = 0; i < count && !malformed; ++i) {
+                unsigned int id = 0;
+                PxTransform recorded;
+                if (!(read(id) && readPose(recorded))) {
+                    malformed = true;
+                    break;
+                }
+                PxRigidActor* actor = engine.getActor(id);
+                float error = actor != nullptr ? (actor->getGlobalPose().p - recorded.p).magnitude() : PX_MAX_F32;
+                maxError = std::max(maxError, error);
+                if (error > 1e-4f && !diverged) {
+                    diverged = true;
+                    firstDivergentStep = step;
+                }
+            }
+            ++numCheckpoints;
+        } else {
+            std::cout << "Unknown record type " << int(type) << " at byte " << recordStart << " of the PhysX recording, stopping replay" << std::endl;
+            return false;
+        }
+        if (malformed) {
+            std::cout << "PhysX recording is truncated or malformed at byte " << recordStart << " (step " << stepTimes.size()
+                      << "), stopping replay" << std::endl;
+            return false;
+        }
+    }
+    double total = duration_cast<duration<double, std::milli>>(steady_clock::now() - start).count();
+
+    // report
+    std::cout << "PhysX replay: " << stepTimes.size() << " steps in " << total << " ms" << std::endl;
+    if (!stepTimes.empty()) {
+        std::vector<double> sorted = stepTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double t : sorted) {
+            sum += t;
+        }
+        size_t worst = size_t(std::max_element(stepTimes.begin(), stepTimes.end()) - stepTimes.begin());
+        std::cout << "  step ms avg " << sum / sorted.size() << " | p50 " << sorted[sorted.size() / 2]
+                  << " | p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]
+                  << " | max " << sorted.back() << " (step " << worst << ")" << std::endl;
+    }
+    std::cout << "  checkpoints " << numCheckpoints << " | max position error " << maxError;
+    if (diverged)
+        std::cout << " | first divergence at step " << firstDivergentStep;
+    std::cout << std::endl;
+    if (rawBytes > 0) {
+        std::cout << "  replication updates " << rawBytes << " B | LZ " << lzBytes << " B (" << 100.0 * lzBytes / rawBytes
+                  << "%) in " << lzMs << " ms | pose stream " << poseBytes << " B (" << 100.0 * poseBytes / rawBytes << "%) in "
+                  << poseMs << " ms" << std::endl;
+    }
+    return true;
+}
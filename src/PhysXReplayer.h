@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Aftr {
+// Re-runs a recording made by PhysXRecorder as fast as possible on a PhysXEngine of its
+// own, without a window or any WOs (see --replay in main.cpp). Times every step, compares
+// the simulation against the recorded pose checkpoints and measures what replicating
+// every step's moved poses would cost, LZ compressed and through a PoseStreamCompressor.
+class PhysXReplayer {
+public:
+    explicit PhysXReplayer(const std::string& fileName);
+
+    bool isOpen() const { return valid; }
+
+    // replays the whole recording and prints a timing/divergence report; false if the
+    // recording turned out to be truncated or malformed, the replay stops right there
+    bool run();
+
+private:
+    std::vector<char> data;
+    size_t cursor;
+    bool valid;
+    unsigned int numShards; // shard layout of the recorded engine
+    float shardWidth;
+
+    template <typename T>
+    bool read(T& value);
+    bool readString(std::string& value);
+};
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "PhysXUserData.h"
+
+namespace Aftr {
+// Interface for objects that own a PhysX trigger shape. The listener registers as the
+// owner of its trigger's id (PhysXEngine::setTriggerOwner), and the game thread forwards
+// the batched trigger events drained from the PhysXEventQueue to it.
+class PhysXTriggerListener {
+public:
+    virtual ~PhysXTriggerListener() {}
+
+    // other is the userData of the overlapping actor, nullptr if it has none
+    virtual void onPhysXTriggerEnter(const PhysXUserData* other) = 0;
+    virtual void onPhysXTriggerExit(const PhysXUserData* other) = 0;
+};
+}
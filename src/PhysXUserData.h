@@ -0,0 +1,18 @@
+#pragma once
+
+namespace Aftr {
+enum class PHYSX_USER_DATA_TYPE : unsigned char {
+    pudBODY, // owned by a WOPhysXActor
+    pudTRIGGER, // owned by a PhysXTriggerListener
+    pudPROXY // kinematic proxy following something that isn't simulated (e.g. the camera), no owner
+};
+
+// What the userData of every actor created by PhysXEngine points at. The engine keeps
+// these until shutdown, so events and scene queries can hand them around as void* even
+// after the actor or its owner is gone. Owners are looked up by id on the game thread,
+// see PhysXEngine::getBodyOwner.
+struct PhysXUserData {
+    PHYSX_USER_DATA_TYPE type;
+    unsigned int id; // PhysXEngine actor id, unused for proxies
+};
+}
@@ -1,6 +1,7 @@
 #include "WOWayPointAbstract.h"
 #include "PhysicsModuleWayPoints.h"
 #include "GLViewPhysicsModule.h"
+#include "PhysXEngine.h"
 #include <vector>
 #include <iostream>
 
@@ -17,10 +18,23 @@ WOWP1* WOWP1::New(const WayPointParametersBase& params, float radius )
 WOWP1::WOWP1(const WayPointParametersBase& params, float radius
              ) : WOWayPointSpherical( params, radius ), IFace( this )
 {
+   this->radius = radius;
+   this->physxEngine = nullptr;
+   this->physxTriggerID = 0;
+   this->triggerPosition = Vector( 0, 0, 0 );
+   this->physxTriggerFrequency = static_cast<unsigned int>( params.frequency );
+   this->physxTriggered = false;
 }
 
 WOWP1::~WOWP1()
 {
+   if( this->physxEngine != nullptr )
+   {
+      //events still queued for the trigger must not reach us, the trigger itself goes after any move queued for it
+      unsigned int id = this->physxTriggerID;
+      this->physxEngine->setTriggerOwner( id, nullptr );
+      this->physxEngine->execute( [id]( PhysXEngine& engine ) { engine.destroyActor( id ); } );
+   }
 }
 
 void WOWP1::onTrigger()
@@ -28,4 +42,64 @@ void WOWP1::onTrigger()
    std::cout << "WOWP1 waypoint Triggered!" << std::endl << std::endl;
 }
 
+void WOWP1::onUpdateWO()
+{
+   //once PhysX owns the trigger volume, skip the engine's per-frame sphere test but nothing else a WO does
+   if( this->physxEngine == nullptr )
+   {
+      WOWayPointSpherical::onUpdateWO();
+      return;
+   }
+   WO::onUpdateWO();
+
+   //however the waypoint was moved, the trigger volume follows
+   Vector p = this->getPosition();
+   if( p.x != this->triggerPosition.x || p.y != this->triggerPosition.y || p.z != this->triggerPosition.z )
+   {
+      unsigned int id = this->physxTriggerID;
+      physx::PxVec3 position( p.x, p.y, p.z );
+      this->physxEngine->execute( [id, position]( PhysXEngine& engine ) { engine.moveTrigger( id, position ); } );
+      this->triggerPosition = p;
+   }
+}
+
+void WOWP1::setPhysXEngine( const std::shared_ptr<PhysXEngine>& engine )
+{
+   if( this->physxEngine != nullptr )
+   {
+      unsigned int id = this->physxTriggerID;
+      this->physxEngine->setTriggerOwner( id, nullptr );
+      this->physxEngine->execute( [id]( PhysXEngine& engine ) { engine.destroyActor( id ); } );
+   }
+
+   this->physxEngine = engine;
+   this->physxTriggerID = engine->reserveID();
+   engine->setTriggerOwner( this->physxTriggerID, this );
+   this->triggerPosition = this->getPosition();
+
+   unsigned int id = this->physxTriggerID;
+   physx::PxVec3 position( this->triggerPosition.x, this->triggerPosition.y, this->triggerPosition.z );
+   float r = this->radius;
+   engine->execute( [id, position, r]( PhysXEngine& e ) { e.createTriggerSphere( id, position, r ); } );
+}
+
+void WOWP1::onPhysXTriggerEnter( const PhysXUserData* other )
+{
+   //bodies flying through don't count, only the camera does (see WayPointParametersBase::useCamera)
+   if( other == nullptr || other->type != PHYSX_USER_DATA_TYPE::pudPROXY )
+      return;
+
+   //same rate limit as the sphere test, at most one trigger per frequency milliseconds
+   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+   if( this->physxTriggered && now - this->lastPhysXTrigger < std::chrono::milliseconds( this->physxTriggerFrequency ) )
+      return;
+   this->physxTriggered = true;
+   this->lastPhysXTrigger = now;
+   this->onTrigger();
+}
+
+void WOWP1::onPhysXTriggerExit( const PhysXUserData* other )
+{
+}
+
 } //namespace Aftr
\ No newline at end of file
@@ -1,20 +1,39 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
+
 #include "WOWayPointSpherical.h"
+#include "PhysXTriggerListener.h"
 
 namespace Aftr
 {
+class PhysXEngine;
 
-class WOWP1 : public WOWayPointSpherical
+class WOWP1 : public WOWayPointSpherical, public PhysXTriggerListener
 {
 public:	
    static WOWP1* New(const WayPointParametersBase& params, float radius);
    virtual ~WOWP1();
    virtual void onTrigger();
+   virtual void onUpdateWO();
+
+   /// Backs this waypoint with a PhysX trigger sphere so overlaps come from the
+   /// broadphase instead of the per-frame sphere test. The sphere follows the
+   /// waypoint when it is moved, and only the camera's proxy sets it off.
+   void setPhysXEngine(const std::shared_ptr<PhysXEngine>& engine);
+   virtual void onPhysXTriggerEnter(const PhysXUserData* other);
+   virtual void onPhysXTriggerExit(const PhysXUserData* other);
 protected:
    WOWP1( const WayPointParametersBase& params, float radius );
 
+   float radius;
+   std::shared_ptr<PhysXEngine> physxEngine;
+   unsigned int physxTriggerID; ///< valid while physxEngine is set
+   Vector triggerPosition; ///< where the trigger was last placed
+   unsigned int physxTriggerFrequency; ///< milliseconds between PhysX triggers, WayPointParametersBase::frequency
+   bool physxTriggered; ///< lastPhysXTrigger is set
+   std::chrono::steady_clock::time_point lastPhysXTrigger;
 };
 
-} //namespace Aftr
-
+} //namespace Aftr
\ No newline at end of file
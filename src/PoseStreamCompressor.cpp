@@ -0,0 +1,76 @@
+#include "PoseStreamCompressor.h"
+
+#include <cstring>
+
+#include "LZCompressor.h"
+
+using namespace Aftr;
+
+// upper bound on ids accepted from the wire, keeps a corrupt packet from exhausting memory
+static const unsigned int maxID = 1 << 24;
+
+std::array<char, PoseStreamCompressor::BODY_SIZE>& PoseStreamCompressor::getLastRecord(unsigned int id)
+{
+    if (id >= lastRecords.size()) {
+        std::array<char, BODY_SIZE> zero;
+        zero.fill(0);
+        lastRecords.resize(id + 1, zero);
+    }
+    return lastRecords[id];
+}
+
+void PoseStreamCompressor::compress(const char* records, unsigned int count, std::string& out)
+{
+    // layout before LZ: count ids, then BODY_SIZE byte planes of count bytes each
+    size_t bodies = size_t(count) * sizeof(uint32_t);
+    scratch.resize(size_t(count) * sizeof(PoseWire));
+
+    for (unsigned int r = 0; r < count; ++r) {
+        const char* record = records + size_t(r) * sizeof(PoseWire);
+        PoseWire w;
+        PoseWire::decode(record, w);
+
+        std::memcpy(&scratch[size_t(r) * sizeof(uint32_t)], record, sizeof(uint32_t));
+        std::array<char, BODY_SIZE>& last = getLastRecord(w.id);
+        const char* body = record + sizeof(uint32_t);
+        for (size_t k = 0; k < BODY_SIZE; ++k) {
+            scratch[bodies + k * count + r] = char(body[k] ^ last[k]);
+            last[k] = body[k];
+        }
+    }
+
+    LZCompressor::compress(scratch.data(), scratch.size(), out);
+}
+
+bool PoseStreamCompressor::decompress(const char* data, size_t size, unsigned int count, std::string& out)
+{
+    size_t bodies = size_t(count) * sizeof(uint32_t);
+    scratch.clear();
+    if (!LZCompressor::decompress(data, size, size_t(count) * sizeof(PoseWire), scratch))
+        return false;
+
+    // ids first, every one is checked before the first record touches the context
+    out.resize(size_t(count) * sizeof(PoseWire));
+    for (unsigned int r = 0; r < count; ++r) {
+        char* record = &out[size_t(r) * sizeof(PoseWire)];
+        std::memcpy(record, &scratch[size_t(r) * sizeof(uint32_t)], sizeof(uint32_t));
+
+        PoseWire w;
+        PoseWire::decode(record, w);
+        if (w.id >= maxID)
+            return false;
+    }
+
+    for (unsigned int r = 0; r < count; ++r) {
+        char* record = &out[size_t(r) * sizeof(PoseWire)];
+        PoseWire w;
+        PoseWire::decode(record, w);
+        std::array<char, BODY_SIZE>& last = getLastRecord(w.id);
+        char* body = record + sizeof(uint32_t);
+        for (size_t k = 0; k < BODY_SIZE; ++k) {
+            body[k] = char(scratch[bodies + k * count + r] ^ last[k]);
+            last[k] = body[k];
+        }
+    }
+    return true;
+}
\ No newline at end of file
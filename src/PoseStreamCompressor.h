@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "PoseWire.h"
+
+namespace Aftr {
+// Pose aware compression context for one replication connection. Each record is
+// XORed against the last record sent for the same id on this connection (the
+// shared context), the result is split into byte planes so the mostly zero sign
+// and exponent bytes line up, and the planes are LZ compressed. Both ends keep an
+// identical context as long as every compressed packet is decoded, in order.
+class PoseStreamCompressor {
+public:
+    // compresses count consecutive PoseWire records and appends the result to out
+    void compress(const char* records, unsigned int count, std::string& out);
+    // inverse of compress, replaces out with count PoseWire records; false on malformed input,
+    // which leaves the context as it was
+    bool decompress(const char* data, size_t size, unsigned int count, std::string& out);
+    // forget every previous record, e.g. when a new session starts
+    void reset() { lastRecords.clear(); }
+
+private:
+    static const size_t BODY_SIZE = sizeof(PoseWire) - sizeof(uint32_t); // everything but the id
+
+    std::vector<std::array<char, BODY_SIZE>> lastRecords; // indexed by id
+    std::string scratch;
+
+    std::array<char, BODY_SIZE>& getLastRecord(unsigned int id);
+};
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "PoseWire.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace Aftr;
+
+namespace {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const bool bigEndianHost = true;
+#else
+const bool bigEndianHost = false;
+#endif
+
+void swapBytes(PoseWire& w)
+{
+    // every field is 4 bytes wide
+    unsigned char* p = reinterpret_cast<unsigned char*>(&w);
+    for (size_t i = 0; i < sizeof(PoseWire); i += 4) {
+        unsigned char a = p[i], b = p[i + 1];
+        p[i] = p[i + 3];
+        p[i + 1] = p[i + 2];
+        p[i + 2] = b;
+        p[i + 3] = a;
+    }
+}
+}
+
+void PoseWire::encode(char* out, unsigned int id, const Mat4& displayMatrix, const Vector& position)
+{
+    PoseWire w;
+    w.id = id;
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            w.rotation[i * 3 + j] = displayMatrix[i * 4 + j];
+        }
+    }
+    w.position[0] = position.x;
+    w.position[1] = position.y;
+    w.position[2] = position.z;
+
+    if (bigEndianHost)
+        swapBytes(w);
+    std::memcpy(out, &w, sizeof(w));
+}
+
+void PoseWire::decode(const char* in, PoseWire& out)
+{
+    std::memcpy(&out, in, sizeof(out));
+    if (bigEndianHost)
+        swapBytes(out);
+}
+
+void PoseWire::runBenchmark(size_t numPoses, unsigned int iterations)
+{
+    using namespace std::chrono;
+
+    Mat4 m;
+    std::vector<char> buffer(numPoses * sizeof(PoseWire));
+
+    auto start = steady_clock::now();
+    for (unsigned int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < numPoses; ++i) {
+            encode(&buffer[i * sizeof(PoseWire)], static_cast<unsigned int>(i), m, Vector(float(i), float(it), 0.0f));
+        }
+    }
+    double encodeSec = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    // sum the decoded values so the loop can't be optimized away
+    float checksum = 0.0f;
+    PoseWire w;
+    start = steady_clock::now();
+    for (unsigned int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < numPoses; ++i) {
+            decode(&buffer[i * sizeof(PoseWire)], w);
+            checksum += w.position[0] + w.rotation[0];
+        }
+    }
+    double decodeSec = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    double poses = double(numPoses) * iterations;
+    double mb = poses * sizeof(PoseWire) / (1024.0 * 1024.0);
+    std::cout << "PoseWire benchmark (" << numPoses << " poses x " << iterations << "):" << std::endl;
+    std::cout << "  encode " << poses / encodeSec / 1e6 << " Mposes/s, " << mb / encodeSec << " MB/s" << std::endl;
+    std::cout << "  decode " << poses / decodeSec / 1e6 << " Mposes/s, " << mb / decodeSec << " MB/s (checksum " << checksum << ")" << std::endl;
+}
\ No newline at end of file
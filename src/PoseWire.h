@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "Mat4.h"
+#include "Vector.h"
+
+namespace Aftr {
+// Fixed layout wire format of one replicated pose: little endian, no padding,
+// 52 bytes. On little endian hosts encoding and decoding are a single memcpy.
+#pragma pack(push, 1)
+struct PoseWire {
+    uint32_t id;
+    float rotation[9]; // row major 3x3 rotation/scale of the display matrix
+    float position[3];
+
+    // encodes a pose into sizeof(PoseWire) bytes at out
+    static void encode(char* out, unsigned int id, const Mat4& displayMatrix, const Vector& position);
+    // decodes sizeof(PoseWire) bytes at in, in may be unaligned
+    static void decode(const char* in, PoseWire& out);
+
+    // measures encode/decode throughput over numPoses poses and prints the results
+    static void runBenchmark(size_t numPoses = 100000, unsigned int iterations = 50);
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PoseWire) == 52, "PoseWire must not be padded");
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "ReplicationLatency.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace Aftr;
+
+uint64_t Aftr::getReplicationClock()
+{
+    using namespace std::chrono;
+    return uint64_t(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::add(int64_t microseconds)
+{
+    microseconds = std::max(microseconds, int64_t(0));
+
+    size_t bucket = 0;
+    while (bucket < NUM_BUCKETS - 1 && microseconds > (FIRST_BUCKET_US << bucket))
+        ++bucket;
+
+    ++buckets[bucket];
+    ++count;
+    sum += microseconds;
+    max = std::max(max, microseconds);
+}
+
+void LatencyHistogram::clear()
+{
+    std::fill(buckets, buckets + NUM_BUCKETS, size_t(0));
+    count = 0;
+    sum = 0;
+    max = 0;
+}
+
+double LatencyHistogram::getPercentileMs(double p) const
+{
+    if (count == 0)
+        return 0.0;
+
+    size_t rank = std::max(size_t(1), size_t(p * count + 0.5));
+    size_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS - 1; ++i) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(double(FIRST_BUCKET_US << i), double(max)) / 1000.0;
+    }
+    return getMaxMs();
+}
+
+void LatencyHistogram::print(std::ostream& os, const char* name) const
+{
+    os << name << " " << count << " | mean " << getMeanMs() << " ms | p50 " << getPercentileMs(0.5) << " | p90 "
+       << getPercentileMs(0.9) << " | p99 " << getPercentileMs(0.99) << " | max " << getMaxMs() << " ms";
+}
+
+ClockSync::ClockSync()
+{
+    numSamples = 0;
+    nextSample = 0;
+    offset = 0;
+    roundTrip = 0;
+}
+
+void ClockSync::addSample(uint64_t t0, uint64_t t1, uint64_t t2, uint64_t t3)
+{
+    // the time the remote side held the request doesn't count towards the round trip
+    Sample s;
+    s.offset = ((int64_t(t1) - int64_t(t0)) + (int64_t(t2) - int64_t(t3))) / 2;
+    s.roundTrip = std::max(int64_t(0), (int64_t(t3) - int64_t(t0)) - (int64_t(t2) - int64_t(t1)));
+
+    samples[nextSample] = s;
+    nextSample = (nextSample + 1) % NUM_SAMPLES;
+    numSamples = std::min(numSamples + 1, size_t(NUM_SAMPLES));
+
+    const Sample* best = std::min_element(samples, samples + numSamples,
+        [](const Sample& a, const Sample& b) { return a.roundTrip < b.roundTrip; });
+    offset = best->offset;
+    roundTrip = best->roundTrip;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+namespace Aftr {
+// monotonic microsecond clock replication timestamps are taken with; every instance
+// has its own epoch, ClockSync estimates the offset between two of them
+uint64_t getReplicationClock();
+
+// timestamps travel as two u32 halves
+inline unsigned int getTimestampHigh(uint64_t t) { return static_cast<unsigned int>(t >> 32); }
+inline unsigned int getTimestampLow(uint64_t t) { return static_cast<unsigned int>(t); }
+inline uint64_t makeTimestamp(unsigned int high, unsigned int low) { return (uint64_t(high) << 32) | low; }
+
+// Fixed size latency histogram with power of two buckets from 0.1 ms up to ~3.3 s,
+// cheap enough to add to for every received packet.
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    // negative samples (clock estimate slightly off) count as 0
+    void add(int64_t microseconds);
+    void clear();
+
+    size_t getCount() const { return count; }
+    double getMeanMs() const { return count > 0 ? double(sum) / count / 1000.0 : 0.0; }
+    double getMaxMs() const { return max / 1000.0; }
+    // upper edge of the bucket holding the p-th percentile (p in [0, 1]), capped at the max
+    double getPercentileMs(double p) const;
+
+    // one line: count, mean, p50, p90, p99, max
+    void print(std::ostream& os, const char* name) const;
+
+private:
+    static const size_t NUM_BUCKETS = 16; // bucket i holds samples up to 100 us << i, the last one everything above
+    static const int64_t FIRST_BUCKET_US = 100;
+
+    size_t buckets[NUM_BUCKETS];
+    size_t count;
+    int64_t sum;
+    int64_t max;
+};
+
+// NTP style clock offset estimate between us and a remote instance. Each sample is
+// one request/response exchange: t0 we sent, t1 remote received, t2 remote replied,
+// t3 we received. Of the last few samples, the one with the shortest round trip is
+// trusted, since queueing delay only ever makes the estimate worse.
+class ClockSync {
+public:
+    ClockSync();
+
+    void addSample(uint64_t t0, uint64_t t1, uint64_t t2, uint64_t t3);
+
+    bool isSynced() const { return numSamples > 0; }
+    int64_t getOffset() const { return offset; } // remote clock minus ours, in microseconds
+    int64_t getRoundTrip() const { return roundTrip; } // network part of the best sample's round trip
+    // remote timestamp expressed on our clock
+    uint64_t toLocal(uint64_t remote) const { return uint64_t(int64_t(remote) - offset); }
+
+private:
+    static const size_t NUM_SAMPLES = 8;
+
+    struct Sample {
+        int64_t offset;
+        int64_t roundTrip;
+    };
+
+    Sample samples[NUM_SAMPLES];
+    size_t numSamples;
+    size_t nextSample;
+    int64_t offset;
+    int64_t roundTrip;
+};
+}
@@ -0,0 +1,394 @@
+#include "ReplicationServer.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#include "NetMessengerClient.h"
+#include "NetMsg.h"
+#include "NetMsgClockSync.h"
+#include "NetMsgSnapshotChunk.h"
+
+using namespace Aftr;
+
+// bytes of compressed snapshot per NetMsgSnapshotChunk
+static const size_t snapshotChunkSize = 8 * 1024;
+
+ReplicationSession::ReplicationSession(const std::string& host, const std::string& port, size_t maxQueuedBytes, bool compression)
+    : host(host)
+    , port(port)
+{
+    this->maxQueuedBytes = maxQueuedBytes;
+    this->compression = compression;
+    queuedBytes = 0;
+    stopping = false;
+    slowTicks = 0;
+    connected = true;
+    bytesSent = 0;
+    packetsDropped = 0;
+    updateBytesRaw = 0;
+    updateBytesCompressed = 0;
+    compressMicroseconds = 0;
+    hasView = false;
+    viewDistance = 0.0f;
+    droppedSeen = 0;
+    unspentBytes = 0;
+    snapshot = nullptr;
+    snapshotRawSize = 0;
+    snapshotOffset = 0;
+    snapshotTick = 0;
+    snapshotID = 0;
+}
+
+void ReplicationSession::start()
+{
+    std::shared_ptr<ReplicationSession> self = shared_from_this();
+    std::thread([self]() { self->run(); }).detach();
+}
+
+void ReplicationSession::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+}
+
+void ReplicationSession::setView(const Vector& position, float viewDistance)
+{
+    hasView = true;
+    viewPosition = position;
+    this->viewDistance = viewDistance;
+}
+
+bool ReplicationSession::getView(Vector& position) const
+{
+    if (hasView)
+        position = viewPosition;
+    return hasView;
+}
+
+void ReplicationSession::sendSnapshot(const std::shared_ptr<const std::string>& compressed, size_t rawSize, unsigned int tick)
+{
+    snapshot = compressed;
+    snapshotRawSize = rawSize;
+    snapshotOffset = 0;
+    snapshotTick = tick;
+    ++snapshotID;
+}
+
+bool ReplicationSession::sendSnapshotChunks(size_t budget, size_t numBodies)
+{
+    unsigned int numChunks = static_cast<unsigned int>((snapshot->size() + snapshotChunkSize - 1) / snapshotChunkSize);
+    if (numChunks == 0)
+        numChunks = 1;
+
+    // always make progress, even if the budget is smaller than a chunk
+    do {
+        size_t size = std::min(snapshotChunkSize, snapshot->size() - snapshotOffset);
+        std::shared_ptr<NetMsgSnapshotChunk> msg = std::make_shared<NetMsgSnapshotChunk>();
+        msg->snapshotID = snapshotID;
+        msg->index = static_cast<unsigned int>(snapshotOffset / snapshotChunkSize);
+        msg->numChunks = numChunks;
+        msg->rawSize = static_cast<unsigned int>(snapshotRawSize);
+        msg->data.assign(snapshot->data() + snapshotOffset, size);
+        enqueue(msg, size, false);
+
+        snapshotOffset += size;
+        budget = budget > size ? budget - size : 0;
+    } while (snapshotOffset < snapshot->size() && budget >= snapshotChunkSize);
+
+    if (snapshotOffset < snapshot->size())
+        return false;
+
+    // the client now has every body as of the snapshot tick, only send later changes
+    snapshot = nullptr;
+    lastSentTick.assign(numBodies, snapshotTick);
+    priority.assign(numBodies, 0.0f);
+    return true;
+}
+
+void ReplicationSession::replicate(const std::vector<ReplicatedBody>& bodies, unsigned int tick, size_t bytesPerTick)
+{
+    if (snapshot != nullptr && !sendSnapshotChunks(bytesPerTick, bodies.size()))
+        return;
+
+    // bodies whose updates were dropped may now be stale on the client, resend everything
+    // (the accumulator spreads that over as many ticks as the budget needs)
+    if (packetsDropped != droppedSeen) {
+        droppedSeen = packetsDropped;
+        std::fill(lastSentTick.begin(), lastSentTick.end(), 0);
+    }
+    priority.resize(bodies.size(), 0.0f);
+    lastSentTick.resize(bodies.size(), 0);
+
+    candidates.clear();
+    for (unsigned int i = 0; i < bodies.size(); ++i) {
+        const ReplicatedBody& b = bodies[i];
+        if (!b.valid || b.lastUpdateTick <= lastSentTick[i])
+            continue;
+
+        float distance = 0.0f;
+        if (hasView) {
+            float dx = b.position.x - viewPosition.x;
+            float dy = b.position.y - viewPosition.y;
+            float dz = b.position.z - viewPosition.z;
+            distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+            // irrelevant for now, stays dirty so it is sent once it comes back into view
+            if (distance > viewDistance)
+                continue;
+        }
+
+        // near, fast and recently collided bodies go first; everything else keeps
+        // accumulating so it is eventually sent
+        float p = 1.0f / (1.0f + distance / 25.0f);
+        p *= 1.0f + b.speed / 5.0f;
+        if (b.lastCollisionTick != 0 && tick - b.lastCollisionTick < 30)
+            p *= 4.0f;
+        priority[i] += p;
+        candidates.push_back(std::make_pair(priority[i], i));
+    }
+
+    // a budget smaller than one update still gets one through every few ticks; carrying
+    // more than that would let idle ticks add up to a burst
+    size_t budget = bytesPerTick + unspentBytes;
+    size_t maxCount = budget / NetMsgUpdateModel::UPDATE_SIZE;
+    if (candidates.size() > maxCount) {
+        std::nth_element(candidates.begin(), candidates.begin() + maxCount, candidates.end(),
+            [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+        candidates.resize(maxCount);
+    }
+    unspentBytes = std::min(budget - candidates.size() * NetMsgUpdateModel::UPDATE_SIZE, size_t(NetMsgUpdateModel::UPDATE_SIZE));
+    if (candidates.empty())
+        return;
+
+    std::string payload;
+    payload.reserve(candidates.size() * NetMsgUpdateModel::UPDATE_SIZE);
+    for (const auto& c : candidates) {
+        payload.append(bodies[c.second].record, NetMsgUpdateModel::UPDATE_SIZE);
+        priority[c.second] = 0.0f;
+        lastSentTick[c.second] = tick;
+    }
+
+    std::shared_ptr<NetMsgUpdateModel> msg = std::make_shared<NetMsgUpdateModel>();
+    msg->count = static_cast<unsigned int>(candidates.size());
+    msg->payload = std::make_shared<const std::string>(std::move(payload));
+    msg->tick = tick;
+    msg->created = getReplicationClock();
+    enqueue(msg, msg->payload->size(), true);
+}
+
+bool ReplicationSession::enqueue(const std::shared_ptr<NetMsg>& msg, size_t bytes, bool droppable)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (droppable) {
+        // newer state supersedes older state, so make room by dropping the oldest updates
+        for (auto it = queue.begin(); it != queue.end() && queuedBytes + bytes > maxQueuedBytes;) {
+            if (it->droppable) {
+                queuedBytes -= it->bytes;
+                it = queue.erase(it);
+                ++packetsDropped;
+            } else {
+                ++it;
+            }
+        }
+        if (queuedBytes + bytes > maxQueuedBytes) {
+            ++packetsDropped;
+            return false;
+        }
+    }
+
+    queue.push_back({ msg, bytes, droppable });
+    queuedBytes += bytes;
+    cv.notify_one();
+    return queuedBytes <= maxQueuedBytes;
+}
+
+LatencyHistogram ReplicationSession::getSendQueueLatency()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return sendQueueLatency;
+}
+
+size_t ReplicationSession::getQueuedBytes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queuedBytes;
+}
+
+unsigned int ReplicationSession::updateSlowTicks()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // a session that keeps dropping or sits above half its budget is not keeping up
+    if (queuedBytes > maxQueuedBytes / 2)
+        ++slowTicks;
+    else
+        slowTicks = 0;
+    return slowTicks;
+}
+
+void ReplicationSession::run()
+{
+    std::unique_ptr<NetMessengerClient> client(NetMessengerClient::New(host, port));
+
+    while (true) {
+        Packet packet;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping)
+                break;
+            packet = queue.front();
+            queue.pop_front();
+        }
+
+        // blocking send happens outside the lock so the simulation can keep queuing
+        std::shared_ptr<NetMsg> msg = compression ? compress(packet.msg) : packet.msg;
+
+        // stamped as late as possible, after queueing and compressing; each update and
+        // answer is built for this session alone, so nobody else reads the stamp
+        uint64_t now = getReplicationClock();
+        if (NetMsgUpdateModel* update = dynamic_cast<NetMsgUpdateModel*>(msg.get())) {
+            update->sent = now;
+            std::lock_guard<std::mutex> lock(mutex);
+            sendQueueLatency.add(int64_t(now - update->created));
+        } else if (NetMsgClockSync* sync = dynamic_cast<NetMsgClockSync*>(msg.get())) {
+            sync->serverSend = now;
+        }
+
+        if (!client->sendNetMsgSynchronousTCP(*msg)) {
+            connected = false;
+            break;
+        }
+        bytesSent += packet.bytes;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedBytes -= packet.bytes;
+    }
+}
+
+std::shared_ptr<NetMsg> ReplicationSession::compress(const std::shared_ptr<NetMsg>& msg)
+{
+    std::shared_ptr<NetMsgUpdateModel> update = std::dynamic_pointer_cast<NetMsgUpdateModel>(msg);
+    if (update == nullptr || update->encoding != NetMsgUpdateModel::ueRAW || update->payload == nullptr)
+        return msg;
+
+    auto before = std::chrono::steady_clock::now();
+    std::string compressed;
+    compressor.compress(update->payload->data(), update->count, compressed);
+    compressMicroseconds += size_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - before).count());
+    updateBytesRaw += update->payload->size();
+    updateBytesCompressed += compressed.size();
+
+    std::shared_ptr<NetMsgUpdateModel> out = std::make_shared<NetMsgUpdateModel>();
+    out->count = update->count;
+    out->encoding = NetMsgUpdateModel::uePOSE_STREAM;
+    out->payload = std::make_shared<const std::string>(std::move(compressed));
+    out->tick = update->tick;
+    out->created = update->created;
+    return out;
+}
+
+ReplicationServer::ReplicationServer(size_t maxQueuedBytesPerSession, unsigned int maxSlowTicks, size_t bytesPerTick, bool compression)
+{
+    this->maxQueuedBytesPerSession = maxQueuedBytesPerSession;
+    this->maxSlowTicks = maxSlowTicks;
+    this->bytesPerTick = bytesPerTick;
+    this->compression = compression;
+}
+
+ReplicationServer::~ReplicationServer()
+{
+    for (auto& s : sessions) {
+        s->stop();
+    }
+}
+
+ReplicationSession* ReplicationServer::addSession(const std::string& host, const std::string& port)
+{
+    // a client that rejoins replaces its old session
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if ((*it)->getHost() == host && (*it)->getPort() == port) {
+            (*it)->stop();
+            it = sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    sessions.push_back(std::make_shared<ReplicationSession>(host, port, maxQueuedBytesPerSession, compression));
+    sessions.back()->start();
+    std::cout << "Replication session joined: " << host << ":" << port << " (" << sessions.size() << " total)" << std::endl;
+    return sessions.back().get();
+}
+
+ReplicationSession* ReplicationServer::getSession(const std::string& host, const std::string& port)
+{
+    for (auto& s : sessions) {
+        if (s->getHost() == host && s->getPort() == port)
+            return s.get();
+    }
+    return nullptr;
+}
+
+void ReplicationServer::replicate(const std::vector<ReplicatedBody>& bodies, unsigned int tick)
+{
+    for (auto& session : sessions) {
+        session->replicate(bodies, tick, bytesPerTick);
+    }
+}
+
+void ReplicationServer::getViews(std::vector<Vector>& out) const
+{
+    Vector position;
+    for (auto& session : sessions) {
+        if (session->getView(position))
+            out.push_back(position);
+    }
+}
+
+void ReplicationServer::broadcast(const std::shared_ptr<NetMsg>& msg, size_t bytes, bool droppable)
+{
+    for (auto& session : sessions) {
+        session->enqueue(msg, bytes, droppable);
+    }
+}
+
+void ReplicationServer::tick()
+{
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        ReplicationSession& s = **it;
+        if (!s.isConnected() || s.updateSlowTicks() > maxSlowTicks) {
+            std::cout << "Replication session dropped: " << s.getHost() << ":" << s.getPort()
+                      << (s.isConnected() ? " (too slow)" : " (disconnected)") << std::endl;
+            s.stop();
+            it = sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ReplicationServer::printStats() const
+{
+    for (auto& s : sessions) {
+        std::cout << "Replication " << s->getHost() << ":" << s->getPort() << " | sent " << s->getBytesSent()
+                  << " B | queued " << s->getQueuedBytes() << " B | dropped " << s->getPacketsDropped();
+        if (s->getUpdateBytesRaw() > 0) {
+            std::cout << " | updates " << s->getUpdateBytesRaw() << " -> " << s->getUpdateBytesCompressed() << " B ("
+                      << 100.0 * s->getUpdateBytesCompressed() / s->getUpdateBytesRaw() << "%) in " << s->getCompressMs() << " ms";
+        }
+        std::cout << std::endl;
+        std::cout << "  ";
+        s->getSendQueueLatency().print(std::cout, "send queue");
+        std::cout << std::endl;
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NetMsgUpdateModel.h"
+#include "PoseStreamCompressor.h"
+#include "ReplicationLatency.h"
+#include "Vector.h"
+
+#ifdef AFTR_CONFIG_USE_BOOST
+
+namespace Aftr {
+class NetMessengerClient;
+class NetMsg;
+
+// simulating side replication state of one model, indexed by model id
+struct ReplicatedBody {
+    std::string path; // spawn parameters, for late join snapshots
+    Vector scale;
+    bool valid = false; // true once the pose has been encoded
+    unsigned int lastUpdateTick = 0; // tick the pose last changed
+    unsigned int lastCollisionTick = 0; // tick of the last reported contact, 0 if none
+    float speed = 0.0f;
+    Vector position;
+    char record[NetMsgUpdateModel::UPDATE_SIZE]; // pose encoded once per change, copied into every packet
+};
+
+// Late join snapshot layout (before compression): u32 model count, then per model
+// u32 id, u32 path length, path bytes, 3 floats scale, one NetMsgUpdateModel record.
+
+// One connected viewer. Packets are queued by the simulation thread and sent by
+// the session's own detached thread, which keeps the session alive until it exits,
+// so a slow link only ever stalls that thread (even while being dropped).
+// With compression on, that thread also compresses each update right before it is
+// sent, so the connection's context only ever sees packets the client receives.
+// Updates and clock sync answers get their send timestamp there as well.
+class ReplicationSession : public std::enable_shared_from_this<ReplicationSession> {
+public:
+    ReplicationSession(const std::string& host, const std::string& port, size_t maxQueuedBytes, bool compression = false);
+    ReplicationSession(const ReplicationSession& other) = delete;
+    ReplicationSession& operator=(const ReplicationSession& other) = delete;
+
+    void start();
+    void stop();
+
+    // sets the viewer used for relevance filtering and prioritization
+    void setView(const Vector& position, float viewDistance);
+    // false until the client has reported its view
+    bool getView(Vector& position) const;
+    // streams a compressed full world snapshot taken at tick, a few chunks per tick
+    // within the session's budget; incremental updates resume once it is queued
+    void sendSnapshot(const std::shared_ptr<const std::string>& compressed, size_t rawSize, unsigned int tick);
+    // queues the changed, relevant bodies with the highest accumulated priority
+    // that fit into bytesPerTick; their records are only copied, never re-encoded
+    void replicate(const std::vector<ReplicatedBody>& bodies, unsigned int tick, size_t bytesPerTick);
+
+    // queues msg for sending; droppable packets (state updates) are discarded,
+    // oldest first, when the queue is over its byte limit. Returns false if the
+    // session is over its limit after queuing.
+    bool enqueue(const std::shared_ptr<NetMsg>& msg, size_t bytes, bool droppable);
+
+    const std::string& getHost() const { return host; }
+    const std::string& getPort() const { return port; }
+    bool isConnected() const { return connected; }
+    size_t getQueuedBytes();
+    size_t getBytesSent() const { return bytesSent; }
+    size_t getPacketsDropped() const { return packetsDropped; }
+    // update bytes before and after compression, and time spent compressing them
+    size_t getUpdateBytesRaw() const { return updateBytesRaw; }
+    size_t getUpdateBytesCompressed() const { return updateBytesCompressed; }
+    double getCompressMs() const { return compressMicroseconds / 1000.0; }
+    // copy of how long updates waited between being queued and being sent
+    LatencyHistogram getSendQueueLatency();
+    // called once per tick, returns how many consecutive ticks the session has been over its limit
+    unsigned int updateSlowTicks();
+
+private:
+    struct Packet {
+        std::shared_ptr<NetMsg> msg;
+        size_t bytes;
+        bool droppable;
+    };
+
+    std::string host;
+    std::string port;
+    size_t maxQueuedBytes;
+    bool compression;
+    PoseStreamCompressor compressor; // only used by the sending thread
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Packet> queue;
+    size_t queuedBytes;
+    bool stopping;
+    unsigned int slowTicks;
+    LatencyHistogram sendQueueLatency; // guarded by mutex
+
+    // interest management, only touched by the simulation thread
+    bool hasView;
+    Vector viewPosition;
+    float viewDistance;
+    std::vector<float> priority; // accumulated per body until it gets sent
+    std::vector<unsigned int> lastSentTick; // per body, 0 = never
+    std::vector<std::pair<float, unsigned int>> candidates; // scratch, (priority, id)
+    size_t droppedSeen;
+    size_t unspentBytes; // budget left over from earlier ticks, at most one update's worth
+
+    // late join snapshot being streamed, nullptr once fully queued
+    std::shared_ptr<const std::string> snapshot;
+    size_t snapshotRawSize;
+    size_t snapshotOffset;
+    unsigned int snapshotTick;
+    unsigned int snapshotID;
+
+    // queues the next snapshot chunks that fit into budget, returns true once the snapshot is fully queued
+    bool sendSnapshotChunks(size_t budget, size_t numBodies);
+
+    std::atomic<bool> connected;
+    std::atomic<size_t> bytesSent;
+    std::atomic<size_t> packetsDropped;
+    std::atomic<size_t> updateBytesRaw;
+    std::atomic<size_t> updateBytesCompressed;
+    std::atomic<size_t> compressMicroseconds;
+
+    void run();
+    // returns the message to put on the wire for msg, compressed if it is a raw update
+    std::shared_ptr<NetMsg> compress(const std::shared_ptr<NetMsg>& msg);
+};
+
+// Fans replication traffic out to every connected session. Messages are built
+// (and their payload encoded) once and shared by reference between sessions.
+class ReplicationServer {
+public:
+    ReplicationServer(size_t maxQueuedBytesPerSession = 256 * 1024, unsigned int maxSlowTicks = 120, size_t bytesPerTick = 16 * 1024,
+        bool compression = false);
+    ~ReplicationServer();
+
+    ReplicationSession* addSession(const std::string& host, const std::string& port);
+    ReplicationSession* getSession(const std::string& host, const std::string& port);
+    void broadcast(const std::shared_ptr<NetMsg>& msg, size_t bytes, bool droppable);
+    // runs interest management for every session and queues this tick's updates
+    void replicate(const std::vector<ReplicatedBody>& bodies, unsigned int tick);
+    // once per tick: drops sessions that disconnected or stayed over their limit for too long
+    void tick();
+
+    size_t getNumSessions() const { return sessions.size(); }
+    // appends the view position of every session that has reported one
+    void getViews(std::vector<Vector>& out) const;
+    void printStats() const;
+
+private:
+    size_t maxQueuedBytesPerSession;
+    unsigned int maxSlowTicks;
+    size_t bytesPerTick; // hard upload budget per session per tick, in uncompressed bytes
+    bool compression; // compress state updates per session, see PoseStreamCompressor
+    std::vector<std::shared_ptr<ReplicationSession>> sessions;
+};
+}
+
+#endif
\ No newline at end of file
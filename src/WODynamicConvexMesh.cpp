@@ -18,6 +18,9 @@ WODynamicConvexMesh::WODynamicConvexMesh()
 
 void WODynamicConvexMesh::createPhysXActor()
 {
-    physxActor = physxEngine->createConvexMesh(this);
-    pushToPhysX();
+    // gathered here, the command may run on the physics thread where the model mustn't be read
+    std::shared_ptr<const PhysXMeshData> mesh = getPhysXMeshData(false);
+    PxTransform pose = getPhysXPose();
+    unsigned int id = physxID;
+    physxEngine->execute([mesh, id, pose](PhysXEngine& engine) { engine.createConvexMesh(*mesh, id, pose); });
 }
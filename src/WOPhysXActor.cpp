@@ -1,5 +1,6 @@
 #include "WOPhysXActor.h"
 #include "Model.h"
+#include "ModelDataShared.h"
 
 using namespace Aftr;
 using namespace physx;
@@ -8,21 +9,31 @@ WOPhysXActor::WOPhysXActor()
     : IFace(this), WO()
 {
     physxEngine = nullptr;
-    physxActor = nullptr;
-    updateCallback = nullptr;
+    physxID = 0;
 }
 
 WOPhysXActor::~WOPhysXActor()
 {
-    if (physxEngine != nullptr && physxActor != nullptr)
-        physxEngine->destroyActor(physxActor);
+    if (physxEngine == nullptr)
+        return;
+
+    // untied right away, so poses and events still on their way never reach this WO;
+    // the actor goes once the commands queued before this one have run
+    unsigned int id = physxID;
+    physxEngine->setBodyOwner(id, nullptr);
+    physxEngine->execute([id](PhysXEngine& engine) { engine.destroyActor(id); });
 }
 
-void WOPhysXActor::pullFromPhysX()
+void WOPhysXActor::applyPhysXPose(const PxVec3& position, const PxQuat& rotation)
 {
-    PxTransform t = physxActor->getGlobalPose();
-    PxMat44 m = PxMat44(t);
-    PxVec3 p = t.p;
+    getModel()->setDisplayMatrix(toDisplayMatrix(rotation));
+    // bypass our override, the pose came from PhysX so there is nothing to push back
+    WO::setPosition(position.x, position.y, position.z);
+}
+
+Mat4 WOPhysXActor::toDisplayMatrix(const PxQuat& rotation)
+{
+    PxMat33 m(rotation);
 
     Mat4 mat;
     for (unsigned int i = 0; i < 3; ++i) {
@@ -30,28 +41,55 @@ void WOPhysXActor::pullFromPhysX()
             mat[i * 4 + j] = m[i][j];
         }
     }
-    getModel()->setDisplayMatrix(mat);
-    setPosition(p.x, p.y, p.z);
-
-    if (updateCallback != nullptr)
-        updateCallback();
+    return mat;
 }
 
-void WOPhysXActor::pushToPhysX() const
+PxTransform WOPhysXActor::getPhysXPose() const
 {
-    if (physxActor != nullptr) {
-        Mat4 mat = getDisplayMatrix();
-        Vector p = getPosition();
+    Mat4 mat = getDisplayMatrix();
+    Vector p = getPosition();
 
-        PxMat44 m;
-        for (unsigned int i = 0; i < 3; ++i) {
-            for (unsigned int j = 0; j < 3; ++j) {
-                m[i][j] = mat[i * 4 + j];
-            }
+    PxMat44 m;
+    for (unsigned int i = 0; i < 3; ++i) {
+        for (unsigned int j = 0; j < 3; ++j) {
+            m[i][j] = mat[i * 4 + j];
         }
-        m[3] = PxVec4(p.x, p.y, p.z, 1.0f);
-        physxActor->setGlobalPose(PxTransform(m));
     }
+    m[3] = PxVec4(p.x, p.y, p.z, 1.0f);
+    return PxTransform(m);
+}
+
+std::shared_ptr<const PhysXMeshData> WOPhysXActor::getPhysXMeshData(bool withIndices)
+{
+    ModelDataShared* modelData = getModel()->getModelDataShared();
+    Vector scale = modelData->getInitialScaleFactor();
+
+    std::shared_ptr<PhysXMeshData> mesh = std::make_shared<PhysXMeshData>();
+    mesh->fileName = modelData->getFileName();
+    mesh->scale = PxVec3(scale.x, scale.y, scale.z);
+    // only the first actor of a model needs its geometry, the rest reuse the cooked shape
+    if (!physxEngine->needsMeshData(mesh->fileName, mesh->scale, withIndices))
+        return mesh;
+
+    const std::vector<Vector>& verts = getModel()->getCompositeVertexList();
+    mesh->vertices.reserve(verts.size());
+    for (const Vector& v : verts) {
+        mesh->vertices.push_back(PxVec3(v.x, v.y, v.z));
+    }
+    if (withIndices)
+        mesh->indices = getModel()->getCompositeIndexList();
+    return mesh;
+}
+
+void WOPhysXActor::pushToPhysX() const
+{
+    if (physxEngine == nullptr)
+        return;
+
+    // by id, this WO may be gone by the time the command runs
+    unsigned int id = physxID;
+    PxTransform pose = getPhysXPose();
+    physxEngine->execute([id, pose](PhysXEngine& engine) { engine.setActorPose(id, pose); });
 }
 
 void WOPhysXActor::setPosition(const Vector& newXYZ)
@@ -128,9 +166,14 @@ void WOPhysXActor::rotateAboutGlobalZ(float deltaRadianAngle)
 
 void WOPhysXActor::setPhysXEngine(const std::shared_ptr<PhysXEngine>& engine) {
     physxEngine = engine;
+    physxID = engine->reserveID();
+    engine->setBodyOwner(physxID, this);
     createPhysXActor();
 }
 
-void WOPhysXActor::setPhysXUpdateCallback(const std::function<void()>& callback) {
-    updateCallback = callback;
+void WOPhysXActor::adoptPhysXActor(const std::shared_ptr<PhysXEngine>& engine, unsigned int id) {
+    // the restored actor and its pose stand, nothing is created or pushed
+    physxEngine = engine;
+    physxID = id;
+    engine->setBodyOwner(id, this);
 }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <functional>
 #include <memory>
 
 #include "WO.h"
@@ -14,9 +13,11 @@ public:
 
     virtual ~WOPhysXActor();
 
-    // pull pose data from PhysX (calls updateCallback)
-    virtual void pullFromPhysX();
-    // push pose data to PhysX
+    // apply a pose from the PhysXEngine's pose store, see PhysXEngine::updateSimulation
+    void applyPhysXPose(const physx::PxVec3& position, const physx::PxQuat& rotation);
+    // display matrix holding rotation, as applyPhysXPose sets it
+    static Mat4 toDisplayMatrix(const physx::PxQuat& rotation);
+    // push pose data to PhysX, through PhysXEngine::execute
     virtual void pushToPhysX() const;
 
     // have to overload all position/rotation updating methods to push those
@@ -37,15 +38,25 @@ public:
 
     // set WO's PhysXEngine, thus creating its PhysX Actor and data
     void setPhysXEngine(const std::shared_ptr<PhysXEngine>& engine);
-    // set callback for when WO receives a PhysX update
-    void setPhysXUpdateCallback(const std::function<void()>& callback);
+    // like setPhysXEngine, but takes over the actor PhysXEngine::loadScene restored under id
+    void adoptPhysXActor(const std::shared_ptr<PhysXEngine>& engine, unsigned int id);
+    // id of the WO's actor, reserved when the engine was set. The WO only ever refers to
+    // its actor by id, the actor itself may only be touched where the scene lives.
+    unsigned int getPhysXID() const { return physxID; }
 
 protected:
     std::shared_ptr<PhysXEngine> physxEngine;
-    physx::PxRigidActor* physxActor;
-    std::function<void()> updateCallback;
+    unsigned int physxID;
 
     WOPhysXActor();
-    virtual void createPhysXActor() = 0; // must be implemented by inheriting classes
+    // runs on the game thread once physxID is reserved: gathers whatever the actor needs
+    // from the WO and queues its creation through PhysXEngine::execute. Must be
+    // implemented by inheriting classes.
+    virtual void createPhysXActor() = 0;
+    // the WO's current pose, as PhysX wants it
+    physx::PxTransform getPhysXPose() const;
+    // the model for PhysXEngine::createTriangleMesh (withIndices) or createConvexMesh, with a
+    // copy of its geometry only if PhysXEngine::needsMeshData says the create needs it
+    std::shared_ptr<const PhysXMeshData> getPhysXMeshData(bool withIndices);
 };
 }
\ No newline at end of file
@@ -18,6 +18,9 @@ WOStaticTriangleMesh::WOStaticTriangleMesh()
 
 void WOStaticTriangleMesh::createPhysXActor()
 {
-    physxActor = physxEngine->createTriangleMesh(this);
-    pushToPhysX();
+    // terrain sized meshes too, only the game thread may read the model
+    std::shared_ptr<const PhysXMeshData> mesh = getPhysXMeshData(true);
+    PxTransform pose = getPhysXPose();
+    unsigned int id = physxID;
+    physxEngine->execute([mesh, id, pose](PhysXEngine& engine) { engine.createTriangleMesh(*mesh, id, pose); });
 }
@@ -2,11 +2,16 @@
 // STEAMiE's Entry Point.
 //**********************************************************************************
 
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <memory>
 #include "GLViewPhysicsModule.h" //GLView subclass instantiated to drive this simulation
+#include "BinaryMesh.h"
+#include "PoseWire.h"
+#include "PhysXReplayer.h"
 
 /// Saves the in passed params argc and argv in a vector of strings.
 std::vector< std::string > saveInputParams( int argc, char** argv );
@@ -21,6 +26,49 @@ std::vector< std::string > saveInputParams( int argc, char** argv );
 int main( int argc, char* argv[] )
 {
    std::vector< std::string > args = saveInputParams( argc, argv ); ///< Command line arguments passed via argc and argv, reserved to size of argc
+
+   //Offline conversion of an OBJ into a binary mesh (see BinaryMesh.h), no window is created:
+   //   --convert-mesh <in.obj> [<out.amesh>] [<scaleX> <scaleY> <scaleZ>]
+   if( args.size() >= 2 && args[1] == "--convert-mesh" )
+   {
+      float scale[3] = { 1, 1, 1 };
+      bool valid = args.size() == 3 || args.size() == 4 || args.size() == 7;
+      for( size_t i = 4; valid && i < args.size(); ++i )
+      {
+         char* end = nullptr;
+         scale[i - 4] = std::strtof( args[i].c_str(), &end );
+         valid = end != args[i].c_str() && *end == '\0' && scale[i - 4] > 0.0f && std::isfinite( scale[i - 4] );
+      }
+      if( !valid )
+      {
+         std::cout << "Usage: " << args[0] << " --convert-mesh <in.obj> [<out.amesh>] [<scaleX> <scaleY> <scaleZ>], scales positive" << std::endl;
+         return 1;
+      }
+      std::string out = args.size() >= 4 ? args[3] : Aftr::BinaryMesh::getBinaryFileName( args[2] );
+      return Aftr::BinaryMesh::convertOBJ( args[2], out, Aftr::Vector( scale[0], scale[1], scale[2] ) ) ? 0 : 1;
+   }
+
+   //Micro-benchmark of the pose wire format's encode/decode throughput, no window is created:
+   //   --benchmark-pose-wire
+   if( args.size() >= 2 && args[1] == "--benchmark-pose-wire" )
+   {
+      Aftr::PoseWire::runBenchmark();
+      return 0;
+   }
+
+   //Offline replay of a PhysX recording (see PhysXReplayer.h) on its own PhysXEngine, no window is created:
+   //   --replay <recording.bin>
+   if( args.size() >= 2 && args[1] == "--replay" )
+   {
+      if( args.size() != 3 )
+      {
+         std::cout << "Usage: " << args[0] << " --replay <recording.bin>" << std::endl;
+         return 1;
+      }
+      Aftr::PhysXReplayer replayer( args[2] );
+      return replayer.run() ? 0 : 1;
+   }
+
    int simStatus = 0;
 
    do